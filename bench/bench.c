@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "bench.h"
+
+// Usage: ./bench [options]
+//   --out FILE        write the JSON results to FILE (default: stdout)
+//   --baseline FILE   compare against a JSON file written by an earlier run
+//   --threshold X     relative slowdown that counts as a regression (0.10)
+//   --cpus A,B        pin the two benchmark threads to cores A and B
+//   --scale X         multiply the amount of work of every case
+//   --filter S        only run cases whose name contains S
+//   --list            list the cases and exit
+//
+// The exit status is 1 if any point regressed against the baseline.
+
+struct bench_opts bench_opts = { { -1, -1 }, 1.0, NULL };
+
+static const struct {
+    const char *name;
+    bench_case_fn fn;
+} bench_cases[] = {
+    { "kfifo_spsc", bench_kfifo_spsc },
+    { "ringbuf_spsc", bench_ringbuf_spsc },
+    { "ringbuf_static_spsc", bench_ringbuf_static_spsc },
+    { "kfifo_rec", bench_kfifo_rec },
+    { "ringbuf_rec", bench_ringbuf_rec },
+    { "list_insert", bench_list_insert },
+    { "list_traverse", bench_list_traverse },
+    { "list_sort", bench_list_sort },
+    { "list_prefetch", bench_list_prefetch },
+    { "hash_lookup", bench_hash_lookup },
+    { "hash_insert", bench_hash_insert },
+    { "rcu_list", bench_rcu_list },
+    { "llist_mpsc", bench_llist_mpsc },
+    { "rbtree_hold", bench_rbtree_hold },
+    { "timer_wheel", bench_timer_wheel },
+    { "lru_hit", bench_lru_hit },
+    { "lru_evict", bench_lru_evict },
+    { "plist_waitq", bench_plist_waitq },
+    { "kfifo_shards", bench_kfifo_shards },
+    { "kdeque_forkjoin", bench_kdeque_forkjoin },
+    { "executor_throughput", bench_executor_throughput },
+    { "executor_wakeup", bench_executor_wakeup },
+    { "chan_rtt", bench_chan_rtt },
+    { "kfifo_dyn_burst", bench_kfifo_dyn_burst },
+    { "kfifo_segq", bench_kfifo_segq },
+    { "kfifo_prio", bench_kfifo_prio },
+};
+
+struct bench_result {
+    char name[64];
+    char params[128];
+    double ops_per_sec;
+};
+
+static struct bench_result *results;
+static size_t nr_results, max_results;
+static FILE *json;
+
+unsigned long long bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void bench_pin(int idx) {
+    cpu_set_t set;
+    int cpu = bench_opts.cpu[idx];
+
+    if (cpu < 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "bench: cannot pin thread to cpu %d, not pinning\n", cpu);
+        bench_opts.cpu[idx] = -1;
+    }
+}
+
+void bench_relax(unsigned int *spins) {
+    if (++*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+        return;
+    }
+    *spins = 0;
+    sched_yield();
+}
+
+unsigned long bench_scaled(unsigned long n) {
+    double v = n * bench_opts.scale;
+    return v < 1 ? 1 : (unsigned long)v;
+}
+
+static int cmp_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_percentiles(unsigned long long *samples, size_t n, struct bench_lat *lat) {
+    memset(lat, 0, sizeof(*lat));
+    if (n == 0)
+        return;
+    qsort(samples, n, sizeof(*samples), cmp_ull);
+    lat->p50 = samples[n * 50 / 100];
+    lat->p90 = samples[n * 90 / 100];
+    lat->p99 = samples[n * 99 / 100];
+    lat->p999 = samples[n * 999 / 1000];
+    lat->max = samples[n - 1];
+}
+
+void bench_report(const char *name, const char *params, double ops,
+    double seconds, const struct bench_lat *lat) {
+    struct bench_result *r;
+    double rate = seconds > 0 ? ops / seconds : 0;
+
+    if (nr_results == max_results) {
+        max_results = max_results ? max_results * 2 : 64;
+        results = realloc(results, max_results * sizeof(*results));
+    }
+    r = &results[nr_results];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->params, sizeof(r->params), "%s", params);
+    r->ops_per_sec = rate;
+
+    fprintf(stderr, "%-22s %-40s %12.0f ops/s %8.2f ns/op", name, params,
+        rate, rate > 0 ? 1e9 / rate : 0);
+    if (lat)
+        fprintf(stderr, "  p50 %.0f p99 %.0f p999 %.0f ns", lat->p50, lat->p99, lat->p999);
+    fprintf(stderr, "\n");
+
+    // one object per line, see load_baseline()
+    fprintf(json, "%s\n  {\"name\": \"%s\", \"params\": \"%s\", \"ops\": %.0f, "
+        "\"seconds\": %.6f, \"ops_per_sec\": %.1f", nr_results ? "," : "",
+        name, params, ops, seconds, rate);
+    if (lat)
+        fprintf(json, ", \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, "
+            "\"p999_ns\": %.0f, \"max_ns\": %.0f",
+            lat->p50, lat->p90, lat->p99, lat->p999, lat->max);
+    fprintf(json, "}");
+    fflush(json);
+    nr_results++;
+}
+
+static int json_field(const char *line, const char *key, char *val, size_t size) {
+    char pat[32];
+    const char *p, *e;
+
+    snprintf(pat, sizeof(pat), "\"%s\": ", key);
+    p = strstr(line, pat);
+    if (!p)
+        return 0;
+    p += strlen(pat);
+    if (*p == '"') {
+        p++;
+        e = strchr(p, '"');
+    } else {
+        e = p + strcspn(p, ",}");
+    }
+    if (!e || (size_t)(e - p) >= size)
+        return 0;
+    memcpy(val, p, e - p);
+    val[e - p] = 0;
+    return 1;
+}
+
+static struct bench_result *load_baseline(const char *path, size_t *n) {
+    struct bench_result *base = NULL;
+    size_t max = 0;
+    char line[1024], rate[32];
+    FILE *f = fopen(path, "r");
+
+    *n = 0;
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (*n == max) {
+            max = max ? max * 2 : 64;
+            base = realloc(base, max * sizeof(*base));
+        }
+        if (json_field(line, "name", base[*n].name, sizeof(base[*n].name)) &&
+            json_field(line, "params", base[*n].params, sizeof(base[*n].params)) &&
+            json_field(line, "ops_per_sec", rate, sizeof(rate))) {
+            base[*n].ops_per_sec = atof(rate);
+            (*n)++;
+        }
+    }
+    fclose(f);
+    return base;
+}
+
+static int compare_baseline(const char *path, double threshold) {
+    size_t nr_base, i, j;
+    struct bench_result *base = load_baseline(path, &nr_base);
+    int regressions = 0;
+
+    fprintf(stderr, "\ncompared with %s:\n", path);
+    for (i = 0; i < nr_results; i++) {
+        for (j = 0; j < nr_base; j++) {
+            if (!strcmp(results[i].name, base[j].name) &&
+                !strcmp(results[i].params, base[j].params))
+                break;
+        }
+        if (j == nr_base || base[j].ops_per_sec <= 0)
+            continue;
+        double ratio = results[i].ops_per_sec / base[j].ops_per_sec;
+        int bad = ratio < 1.0 - threshold;
+        regressions += bad;
+        fprintf(stderr, "%-22s %-40s %+7.1f%%%s\n", results[i].name,
+            results[i].params, (ratio - 1.0) * 100, bad ? "  REGRESSION" : "");
+    }
+    free(base);
+    fprintf(stderr, "%d regression(s)\n", regressions);
+    return regressions != 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out = NULL, *baseline = NULL;
+    double threshold = 0.10;
+    size_t i;
+    int ret = 0;
+
+    for (i = 1; i < (size_t)argc; i++) {
+        const char *arg = argv[i], *val = i + 1 < (size_t)argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(arg, "--list")) {
+            for (i = 0; i < ARRAY_SIZE(bench_cases); i++)
+                printf("%s\n", bench_cases[i].name);
+            return 0;
+        }
+        if (!val) {
+            fprintf(stderr, "usage: %s [--out FILE] [--baseline FILE] [--threshold X] "
+                "[--cpus A,B] [--scale X] [--filter S] [--list]\n", argv[0]);
+            return 2;
+        }
+        if (!strcmp(arg, "--out"))
+            out = val;
+        else if (!strcmp(arg, "--baseline"))
+            baseline = val;
+        else if (!strcmp(arg, "--threshold"))
+            threshold = atof(val);
+        else if (!strcmp(arg, "--cpus"))
+            sscanf(val, "%d,%d", &bench_opts.cpu[0], &bench_opts.cpu[1]);
+        else if (!strcmp(arg, "--scale"))
+            bench_opts.scale = atof(val);
+        else if (!strcmp(arg, "--filter"))
+            bench_opts.filter = val;
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 2;
+        }
+        i++;
+    }
+
+    json = out ? fopen(out, "w") : stdout;
+    if (!json) {
+        perror(out);
+        return 2;
+    }
+    fprintf(json, "{\"benchmarks\": [");
+    for (i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+        if (bench_opts.filter && !strstr(bench_cases[i].name, bench_opts.filter))
+            continue;
+        bench_cases[i].fn();
+    }
+    fprintf(json, "\n]}\n");
+    if (out)
+        fclose(json);
+
+    if (baseline)
+        ret = compare_baseline(baseline, threshold);
+    free(results);
+    return ret;
+}
@@ -0,0 +1,79 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(ary) (sizeof((ary))/sizeof(*(ary)))
+#endif
+
+// Benchmark harness shared by all bench_*.c files.
+//
+// Every case is a function listed in the case table in bench.c. A case runs
+// its parameter sweep and calls bench_report() once per measured point; the
+// harness prints a table to stderr and one JSON object per point to the output
+// file, which can later be passed back with --baseline for comparison.
+
+struct bench_opts {
+    int cpu[2];          // cores for the first and second thread, -1: no pinning
+    double scale;        // multiplies the amount of work of every case
+    const char *filter;  // only run cases whose name contains this
+};
+
+extern struct bench_opts bench_opts;
+
+// latency percentiles in nanoseconds, all 0 if not measured
+struct bench_lat {
+    double p50, p90, p99, p999, max;
+};
+
+typedef void (*bench_case_fn)(void);
+
+// monotonic clock in nanoseconds
+unsigned long long bench_now_ns(void);
+
+// pin the calling thread to bench_opts.cpu[idx], no-op if it is -1
+void bench_pin(int idx);
+
+// busy-wait helper for polling loops: spins first, then yields the CPU
+void bench_relax(unsigned int *spins);
+
+// scale a work amount by bench_opts.scale, at least 1
+unsigned long bench_scaled(unsigned long n);
+
+// sort samples and compute percentiles into *lat
+void bench_percentiles(unsigned long long *samples, size_t n, struct bench_lat *lat);
+
+// record one measured point; lat may be NULL
+void bench_report(const char *name, const char *params, double ops,
+    double seconds, const struct bench_lat *lat);
+
+// cases, see bench_*.c
+void bench_kfifo_spsc(void);
+void bench_ringbuf_spsc(void);
+void bench_ringbuf_static_spsc(void);
+void bench_kfifo_rec(void);
+void bench_ringbuf_rec(void);
+void bench_list_insert(void);
+void bench_list_traverse(void);
+void bench_list_sort(void);
+void bench_list_prefetch(void);
+void bench_hash_lookup(void);
+void bench_hash_insert(void);
+void bench_rcu_list(void);
+void bench_llist_mpsc(void);
+void bench_rbtree_hold(void);
+void bench_timer_wheel(void);
+void bench_lru_hit(void);
+void bench_lru_evict(void);
+void bench_plist_waitq(void);
+void bench_kfifo_shards(void);
+void bench_kdeque_forkjoin(void);
+void bench_executor_throughput(void);
+void bench_executor_wakeup(void);
+void bench_chan_rtt(void);
+void bench_kfifo_dyn_burst(void);
+void bench_kfifo_segq(void);
+void bench_kfifo_prio(void);
+
+#endif // BENCH_H
@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo_chan.h"
+
+// Round trip over a kfifo_chan: the client thread sends a batch of requests
+// and waits for all the replies, the server thread answers every batch it
+// receives with one kfifo_chan_reply(). One sample per batch, from send to
+// the last reply. Run with --cpus A,B to pin client and server.
+
+#define CHAN_MAX_BATCH 16
+
+struct chan_run {
+    struct kfifo_chan chan;
+    unsigned long rounds;
+    unsigned int batch;
+};
+
+static void *chan_server(void *arg) {
+    struct chan_run *run = arg;
+    struct kfifo_msg msgs[CHAN_MAX_BATCH];
+    unsigned long left = run->rounds * run->batch;
+    unsigned int n, done;
+
+    bench_pin(1);
+    while (left) {
+        n = kfifo_chan_recv_wait(&run->chan, msgs, CHAN_MAX_BATCH);
+        for (done = 0; done < n; )
+            done += kfifo_chan_reply(&run->chan, msgs + done, n - done);
+        left -= n;
+    }
+    return NULL;
+}
+
+void bench_chan_rtt(void) {
+    static const int modes[] = { 0, KFIFO_CHAN_PARK };
+    static const unsigned int batches[] = { 1, CHAN_MAX_BATCH };
+    unsigned long rounds = bench_scaled(200000);
+    unsigned long long *samples = malloc(rounds * sizeof(*samples));
+    size_t m, b;
+
+    if (!samples)
+        abort();
+    for (m = 0; m < ARRAY_SIZE(modes); m++) {
+        for (b = 0; b < ARRAY_SIZE(batches); b++) {
+            struct chan_run run;
+            struct kfifo_msg req[CHAN_MAX_BATCH], resp[CHAN_MAX_BATCH];
+            struct bench_lat lat;
+            pthread_t server;
+            unsigned long long t, t0;
+            unsigned long i;
+            unsigned int got, j;
+            char params[64];
+
+            if (kfifo_chan_alloc(&run.chan, 64, modes[m]))
+                abort();
+            run.rounds = rounds;
+            run.batch = batches[b];
+            for (j = 0; j < run.batch; j++) {
+                req[j].op = j;
+                req[j].data = NULL;
+                req[j].len = 0;
+            }
+            pthread_create(&server, NULL, chan_server, &run);
+
+            bench_pin(0);
+            t = bench_now_ns();
+            for (i = 0; i < rounds; i++) {
+                t0 = bench_now_ns();
+                kfifo_chan_send(&run.chan, req, run.batch);
+                for (got = 0; got < run.batch; )
+                    got += kfifo_chan_wait(&run.chan, resp + got, run.batch - got);
+                samples[i] = bench_now_ns() - t0;
+                if (resp[run.batch - 1].id != req[run.batch - 1].id)
+                    abort();
+            }
+            t = bench_now_ns() - t;
+            pthread_join(server, NULL);
+            kfifo_chan_free(&run.chan);
+
+            bench_percentiles(samples, rounds, &lat);
+            snprintf(params, sizeof(params), "wait=%s,batch=%u",
+                modes[m] ? "park" : "spin", run.batch);
+            bench_report("chan_rtt", params, (double)rounds * run.batch, t / 1e9, &lat);
+        }
+    }
+    free(samples);
+}
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo.h"
+#include "../kdeque.h"
+
+// Fork-join: every task of depth d > 0 spawns two tasks of depth d - 1, so a
+// root of depth D makes 2^(D+1) - 1 tasks. Workers run them from per-worker
+// kdeques (pop own, steal from others when empty), or from one shared
+// __kfifo guarded by a mutex on both ends (an MPMC fifo).
+
+#define MAX_WORKERS 8
+
+struct task {
+    long depth;
+};
+
+struct deque_run {
+    int use_deque;
+    unsigned int workers;
+    long pending;
+    DECLARE_KDEQUE(deques[MAX_WORKERS], struct task);
+    struct __kfifo fifo;
+    pthread_mutex_t lock;
+};
+
+struct deque_worker {
+    struct deque_run *run;
+    unsigned int id;
+};
+
+static int deque_get(struct deque_run *run, unsigned int id, struct task *t) {
+    unsigned int i, n;
+
+    if (!run->use_deque) {
+        pthread_mutex_lock(&run->lock);
+        n = __kfifo_out(&run->fifo, t, 1);
+        pthread_mutex_unlock(&run->lock);
+        return n;
+    }
+    if (kdeque_pop(&run->deques[id], t))
+        return 1;
+    for (i = 1; i < run->workers; i++) {
+        if (kdeque_steal(&run->deques[(id + i) % run->workers], t) == 1)
+            return 1;
+    }
+    return 0;
+}
+
+static void deque_put(struct deque_run *run, unsigned int id, struct task *t) {
+    if (!run->use_deque) {
+        pthread_mutex_lock(&run->lock);
+        __kfifo_in(&run->fifo, t, 1);
+        pthread_mutex_unlock(&run->lock);
+        return;
+    }
+    kdeque_push(&run->deques[id], *t);
+}
+
+static void *deque_worker(void *arg) {
+    struct deque_worker *w = arg;
+    struct deque_run *run = w->run;
+    struct task t, child;
+    unsigned int spins = 0;
+
+    bench_pin(w->id & 1);
+    while (__atomic_load_n(&run->pending, __ATOMIC_ACQUIRE) > 0) {
+        if (!deque_get(run, w->id, &t)) {
+            bench_relax(&spins);
+            continue;
+        }
+        if (t.depth > 0) {
+            child.depth = t.depth - 1;
+            __atomic_add_fetch(&run->pending, 2, __ATOMIC_RELAXED);
+            deque_put(run, w->id, &child);
+            deque_put(run, w->id, &child);
+        }
+        __atomic_sub_fetch(&run->pending, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+void bench_kdeque_forkjoin(void) {
+    static const unsigned int workers[] = { 1, 2, 4, 8 };
+    long depth = 10;
+    size_t w;
+    int use_deque;
+
+    while ((1ul << (depth + 1)) < bench_scaled(1ul << 20))
+        depth++;
+    for (w = 0; w < ARRAY_SIZE(workers); w++) {
+        for (use_deque = 0; use_deque < 2; use_deque++) {
+            struct deque_run *run = calloc(1, sizeof(*run));
+            struct deque_worker args[MAX_WORKERS];
+            pthread_t threads[MAX_WORKERS];
+            struct task root = { depth };
+            unsigned long long t;
+            unsigned int i;
+            char params[64];
+
+            run->use_deque = use_deque;
+            run->workers = workers[w];
+            run->pending = 1;
+            pthread_mutex_init(&run->lock, NULL);
+            if (use_deque) {
+                for (i = 0; i < run->workers; i++)
+                    if (kdeque_alloc(&run->deques[i], 64))
+                        abort();
+            } else {
+                __kfifo_alloc(&run->fifo, 2u << depth, sizeof(struct task));
+            }
+            deque_put(run, 0, &root);
+
+            t = bench_now_ns();
+            for (i = 0; i < run->workers; i++) {
+                args[i].run = run;
+                args[i].id = i;
+                pthread_create(&threads[i], NULL, deque_worker, &args[i]);
+            }
+            for (i = 0; i < run->workers; i++)
+                pthread_join(threads[i], NULL);
+            t = bench_now_ns() - t;
+
+            snprintf(params, sizeof(params), "queue=%s,workers=%u,depth=%ld",
+                use_deque ? "kdeque" : "kfifo+mutex", workers[w], depth);
+            bench_report("kdeque_forkjoin", params, (double)(2ul << depth) - 1, t / 1e9, NULL);
+
+            if (use_deque) {
+                for (i = 0; i < run->workers; i++)
+                    kdeque_free(&run->deques[i]);
+            } else {
+                __kfifo_free(&run->fifo);
+            }
+            pthread_mutex_destroy(&run->lock);
+            free(run);
+        }
+    }
+}
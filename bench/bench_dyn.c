@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo.h"
+#include "../kfifo_dyn.h"
+
+// Bursty SPSC traffic: the writer puts bursts of 4096 elements with a pause
+// in between, the reader drains at its own pace. A small fixed __kfifo makes
+// the writer wait, a large one holds its memory forever, a kfifo_dyn grows
+// for the bursts and shrinks back between them. `size` is the largest ring
+// the writer saw.
+
+#define DYN_BURST 4096
+#define DYN_SMALL 64
+#define DYN_LARGE (1u << 16)
+
+struct dyn_run {
+    int use_dyn;
+    struct __kfifo fifo;
+    struct kfifo_dyn dyn;
+    unsigned long items;
+    unsigned int peak;
+};
+
+static void *dyn_writer(void *arg) {
+    struct dyn_run *run = arg;
+    unsigned long buf[256] = { 0 }, i = 0;
+    unsigned int spins = 0, n, k;
+
+    bench_pin(0);
+    while (i < run->items) {
+        for (k = 0; k < DYN_BURST && i < run->items; k += n) {
+            n = ARRAY_SIZE(buf);
+            if (n > run->items - i)
+                n = run->items - i;
+            if (run->use_dyn) {
+                n = kfifo_dyn_in(&run->dyn, buf, n);
+                if (kfifo_dyn_size(&run->dyn) > run->peak)
+                    run->peak = kfifo_dyn_size(&run->dyn);
+            } else {
+                n = __kfifo_in(&run->fifo, buf, n);
+            }
+            if (!n)
+                bench_relax(&spins);
+            i += n;
+        }
+        for (k = 0; k < 20000; k++)
+            __asm__ __volatile__("" ::: "memory");
+    }
+    return NULL;
+}
+
+void bench_kfifo_dyn_burst(void) {
+    static const char *const names[] = { "fixed_small", "fixed_large", "dyn" };
+    unsigned long items = bench_scaled(4000000);
+    size_t m;
+
+    for (m = 0; m < ARRAY_SIZE(names); m++) {
+        struct dyn_run run = { 0 };
+        unsigned long buf[256], got = 0;
+        unsigned long long t;
+        unsigned int spins = 0, n;
+        pthread_t writer;
+        char params[64];
+
+        run.items = items;
+        run.use_dyn = m == 2;
+        if (run.use_dyn) {
+            if (kfifo_dyn_alloc(&run.dyn, DYN_SMALL, DYN_SMALL, DYN_LARGE, sizeof(long)))
+                abort();
+        } else {
+            run.peak = m == 0 ? DYN_SMALL : DYN_LARGE;
+            __kfifo_alloc(&run.fifo, run.peak, sizeof(long));
+        }
+
+        t = bench_now_ns();
+        pthread_create(&writer, NULL, dyn_writer, &run);
+        bench_pin(1);
+        while (got < items) {
+            if (run.use_dyn)
+                n = kfifo_dyn_out(&run.dyn, buf, ARRAY_SIZE(buf));
+            else
+                n = __kfifo_out(&run.fifo, buf, ARRAY_SIZE(buf));
+            if (!n)
+                bench_relax(&spins);
+            got += n;
+        }
+        pthread_join(writer, NULL);
+        t = bench_now_ns() - t;
+
+        snprintf(params, sizeof(params), "ring=%s,size=%u", names[m], run.peak);
+        bench_report("kfifo_dyn_burst", params, (double)items, t / 1e9, NULL);
+        if (run.use_dyn)
+            kfifo_dyn_free(&run.dyn);
+        else
+            __kfifo_free(&run.fifo);
+    }
+}
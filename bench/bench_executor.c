@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "bench.h"
+#include "../kfifo_executor.h"
+
+// Task throughput: one submitter pushes no-op tasks one at a time or in
+// batches of 64, the clock stops when the workers have run all of them.
+// Wakeup latency: the workers are left idle long enough to park, then one
+// task is submitted and measures how long it took to start running.
+
+#define EXEC_BATCH 64
+
+static long exec_done;
+
+static void exec_nop(void *arg) {
+    (void)arg;
+    __atomic_add_fetch(&exec_done, 1, __ATOMIC_RELEASE);
+}
+
+static int exec_start(struct kfifo_executor *ex, unsigned int workers) {
+    int cpus[8];
+    unsigned int i;
+
+    for (i = 0; i < workers && i < ARRAY_SIZE(cpus); i++)
+        cpus[i] = bench_opts.cpu[i & 1];
+    return kfifo_executor_start(ex, workers, 4096, bench_opts.cpu[0] >= 0 ? cpus : NULL);
+}
+
+void bench_executor_throughput(void) {
+    static const unsigned int workers[] = { 1, 2, 4 };
+    static const unsigned int batches[] = { 1, EXEC_BATCH };
+    struct kfifo_task tasks[EXEC_BATCH];
+    unsigned long total = bench_scaled(2000000);
+    size_t w, b;
+    unsigned int i, spins;
+
+    for (i = 0; i < EXEC_BATCH; i++) {
+        tasks[i].fn = exec_nop;
+        tasks[i].arg = NULL;
+    }
+    for (w = 0; w < ARRAY_SIZE(workers); w++) {
+        for (b = 0; b < ARRAY_SIZE(batches); b++) {
+            struct kfifo_executor ex;
+            unsigned long sent = 0;
+            unsigned long long t;
+            char params[64];
+
+            if (exec_start(&ex, workers[w]))
+                abort();
+            exec_done = 0;
+            spins = 0;
+            t = bench_now_ns();
+            while (sent < total) {
+                unsigned int n = total - sent < batches[b] ? total - sent : batches[b];
+
+                if (n == 1)
+                    n = kfifo_executor_submit(&ex, exec_nop, NULL) ? 0 : 1;
+                else
+                    n = kfifo_executor_submit_batch(&ex, tasks, n);
+                if (!n)
+                    bench_relax(&spins);
+                sent += n;
+            }
+            while (__atomic_load_n(&exec_done, __ATOMIC_ACQUIRE) < (long)total)
+                bench_relax(&spins);
+            t = bench_now_ns() - t;
+            kfifo_executor_stop(&ex);
+
+            snprintf(params, sizeof(params), "workers=%u,batch=%u", workers[w], batches[b]);
+            bench_report("executor_throughput", params, (double)total, t / 1e9, NULL);
+        }
+    }
+}
+
+static void exec_stamp(void *arg) {
+    unsigned long long *stamp = arg;
+
+    __atomic_store_n(stamp, bench_now_ns() - *stamp, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&exec_done, 1, __ATOMIC_RELEASE);
+}
+
+void bench_executor_wakeup(void) {
+    struct timespec idle = { 0, 500000 };
+    unsigned long i, n = bench_scaled(2000);
+    unsigned long long *samples = malloc(n * sizeof(*samples));
+    unsigned long long t, stamp;
+    struct kfifo_executor ex;
+    struct bench_lat lat;
+    unsigned int spins = 0;
+
+    if (!samples || exec_start(&ex, 1))
+        abort();
+    exec_done = 0;
+    t = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        nanosleep(&idle, NULL);
+        stamp = bench_now_ns();
+        while (kfifo_executor_submit(&ex, exec_stamp, &stamp))
+            bench_relax(&spins);
+        while (__atomic_load_n(&exec_done, __ATOMIC_ACQUIRE) <= (long)i)
+            bench_relax(&spins);
+        samples[i] = stamp;
+    }
+    t = bench_now_ns() - t;
+    kfifo_executor_stop(&ex);
+
+    bench_percentiles(samples, n, &lat);
+    bench_report("executor_wakeup", "workers=1,idle_us=500", (double)n, t / 1e9, &lat);
+    free(samples);
+}
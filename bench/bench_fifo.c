@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo.h"
+#include "../ringbuf.h"
+#include "../ringbuf_static.h"
+
+// SPSC throughput and latency of __kfifo, ringbuf_t and RINGBUF_DEFINE.
+//
+// One thread writes `items` elements in batches, the other reads them back.
+// Throughput is measured on a plain run. Latency is measured on a second,
+// shorter run where the writer stores a timestamp in the first element of
+// every batch (elements of at least 8 bytes only) and the reader takes the
+// difference when it dequeues that element.
+
+#define MAX_SAMPLES (1u << 16)
+
+struct spsc_ops {
+    void *(*create)(unsigned int cap_bytes, unsigned int esize);
+    unsigned int (*in)(void *q, const void *buf, unsigned int n);
+    unsigned int (*out)(void *q, void *buf, unsigned int n);
+    void (*destroy)(void *q);
+};
+
+struct spsc_run {
+    const struct spsc_ops *ops;
+    void *q;
+    unsigned int esize, batch;
+    unsigned long items;
+    int stamp;
+    unsigned long long *samples;
+    size_t nr_samples;
+};
+
+static void *spsc_writer(void *arg) {
+    struct spsc_run *run = arg;
+    unsigned char *buf = calloc(run->batch, run->esize);
+    unsigned long i = 0;
+    unsigned int spins = 0;
+
+    bench_pin(0);
+    while (i < run->items) {
+        unsigned int n = run->batch, done = 0;
+        unsigned long long now;
+
+        if (n > run->items - i)
+            n = run->items - i;
+        if (run->stamp) {
+            now = bench_now_ns();
+            memcpy(buf, &now, sizeof(now));
+        }
+        while (done < n) {
+            unsigned int l = run->ops->in(run->q, buf + done * run->esize, n - done);
+            if (l == 0)
+                bench_relax(&spins);
+            done += l;
+        }
+        i += n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static void *spsc_reader(void *arg) {
+    struct spsc_run *run = arg;
+    unsigned char *buf = calloc(run->batch, run->esize);
+    unsigned long i = 0;
+    unsigned int spins = 0, j, n;
+    unsigned long long stamp;
+
+    bench_pin(1);
+    while (i < run->items) {
+        n = run->ops->out(run->q, buf, run->batch);
+        if (n == 0) {
+            bench_relax(&spins);
+            continue;
+        }
+        if (run->stamp) {
+            unsigned long long now = bench_now_ns();
+            for (j = 0; j < n; j++) {
+                if ((i + j) % run->batch || run->nr_samples == MAX_SAMPLES)
+                    continue;
+                memcpy(&stamp, buf + j * run->esize, sizeof(stamp));
+                run->samples[run->nr_samples++] = now - stamp;
+            }
+        }
+        i += n;
+    }
+    free(buf);
+    return NULL;
+}
+
+static double spsc_once(struct spsc_run *run) {
+    pthread_t w, r;
+    unsigned long long t0 = bench_now_ns();
+
+    pthread_create(&r, NULL, spsc_reader, run);
+    pthread_create(&w, NULL, spsc_writer, run);
+    pthread_join(w, NULL);
+    pthread_join(r, NULL);
+    return (bench_now_ns() - t0) / 1e9;
+}
+
+static void spsc_point(const char *name, const char *extra, const struct spsc_ops *ops,
+    unsigned int cap_bytes, unsigned int esize, unsigned int batch, unsigned long items) {
+    struct spsc_run run;
+    struct bench_lat lat;
+    char params[128];
+    double secs;
+
+    memset(&run, 0, sizeof(run));
+    run.ops = ops;
+    run.esize = esize;
+    run.batch = batch;
+    run.items = items;
+    run.q = ops->create(cap_bytes, esize);
+    if (!run.q)
+        return;
+    secs = spsc_once(&run);
+    ops->destroy(run.q);
+
+    if (esize >= sizeof(unsigned long long)) {
+        run.q = ops->create(cap_bytes, esize);
+        run.items = items / 4 ? items / 4 : 1;
+        run.stamp = 1;
+        run.samples = malloc(MAX_SAMPLES * sizeof(*run.samples));
+        spsc_once(&run);
+        bench_percentiles(run.samples, run.nr_samples, &lat);
+        free(run.samples);
+        ops->destroy(run.q);
+    }
+
+    snprintf(params, sizeof(params), "%sesize=%u,batch=%u,cap=%u", extra, esize, batch, cap_bytes);
+    bench_report(name, params, items, secs, run.stamp ? &lat : NULL);
+}
+
+static const unsigned int esizes[] = { 1, 8, 64, 512, 4096 };
+static const unsigned int batches[] = { 1, 16, 256 };
+static const unsigned int caps[] = { 4096, 65536, 1u << 20 };
+
+static void spsc_sweep(const char *name, const struct spsc_ops *ops) {
+    size_t e, b, c;
+
+    for (e = 0; e < ARRAY_SIZE(esizes); e++) {
+        for (b = 0; b < ARRAY_SIZE(batches); b++) {
+            for (c = 0; c < ARRAY_SIZE(caps); c++) {
+                unsigned long items = (4ul << 20) / esizes[e];
+                if (caps[c] / esizes[e] < 2)
+                    continue;
+                if (items < 16384)
+                    items = 16384;
+                spsc_point(name, "", ops, caps[c], esizes[e], batches[b], bench_scaled(items));
+            }
+        }
+    }
+}
+
+// struct __kfifo
+
+static void *kfifo_create(unsigned int cap_bytes, unsigned int esize) {
+    struct __kfifo *fifo = malloc(sizeof(*fifo));
+    __kfifo_init(fifo, malloc(cap_bytes), cap_bytes, esize);
+    return fifo;
+}
+
+static void kfifo_destroy(void *q) {
+    struct __kfifo *fifo = q;
+    free(fifo->data);
+    free(fifo);
+}
+
+static unsigned int kfifo_in_fn(void *q, const void *buf, unsigned int n) {
+    return __kfifo_in(q, buf, n);
+}
+
+static unsigned int kfifo_out_fn(void *q, void *buf, unsigned int n) {
+    return __kfifo_out(q, buf, n);
+}
+
+static const struct spsc_ops kfifo_ops = { kfifo_create, kfifo_in_fn, kfifo_out_fn, kfifo_destroy };
+
+void bench_kfifo_spsc(void) {
+    spsc_sweep("kfifo_spsc", &kfifo_ops);
+}
+
+// struct ringbuf_t
+
+static void *ringbuf_create(unsigned int cap_bytes, unsigned int esize) {
+    struct ringbuf_t *rb = malloc(sizeof(*rb));
+    ringbuf_init(rb, esize, malloc(cap_bytes), cap_bytes);
+    return rb;
+}
+
+static void ringbuf_destroy(void *q) {
+    struct ringbuf_t *rb = q;
+    free(rb->data);
+    free(rb);
+}
+
+static unsigned int ringbuf_in_fn(void *q, const void *buf, unsigned int n) {
+    return ringbuf_in(q, buf, n);
+}
+
+static unsigned int ringbuf_out_fn(void *q, void *buf, unsigned int n) {
+    return ringbuf_out(q, buf, n);
+}
+
+static const struct spsc_ops ringbuf_ops = { ringbuf_create, ringbuf_in_fn, ringbuf_out_fn, ringbuf_destroy };
+
+void bench_ringbuf_spsc(void) {
+    spsc_sweep("ringbuf_spsc", &ringbuf_ops);
+}
+
+// RINGBUF_DEFINE, fixed 8 byte items and 4096 item capacity
+
+RINGBUF_DEFINE(u64ring, unsigned long long, 4096);
+
+static void *u64ring_create(unsigned int cap_bytes, unsigned int esize) {
+    struct u64ring *rb = malloc(sizeof(*rb));
+    (void)cap_bytes;
+    (void)esize;
+    u64ring_init(rb);
+    return rb;
+}
+
+static unsigned int u64ring_in_fn(void *q, const void *buf, unsigned int n) {
+    return u64ring_in(q, buf, n);
+}
+
+static unsigned int u64ring_out_fn(void *q, void *buf, unsigned int n) {
+    return u64ring_out(q, buf, n);
+}
+
+static const struct spsc_ops u64ring_ops = { u64ring_create, u64ring_in_fn, u64ring_out_fn, free };
+
+void bench_ringbuf_static_spsc(void) {
+    size_t b;
+
+    for (b = 0; b < ARRAY_SIZE(batches); b++) {
+        spsc_point("ringbuf_static_spsc", "", &u64ring_ops, sizeof(struct u64ring) - 8,
+            8, batches[b], bench_scaled(1ul << 19));
+        spsc_point("kfifo_spsc", "", &kfifo_ops, 4096 * 8, 8, batches[b], bench_scaled(1ul << 19));
+    }
+}
+
+// record fifos: one record of `esize` bytes per element
+
+struct rec_queue {
+    struct __kfifo kfifo;
+    struct ringbuf_t ringbuf;
+    unsigned int len, recsize;
+};
+
+static unsigned int rec_recsize = 1;
+
+static void *rec_create(unsigned int cap_bytes, unsigned int esize) {
+    struct rec_queue *q = malloc(sizeof(*q));
+    void *data = malloc(cap_bytes);
+    __kfifo_init(&q->kfifo, data, cap_bytes, 1);
+    ringbuf_init(&q->ringbuf, 1, data, cap_bytes);
+    q->len = esize;
+    q->recsize = rec_recsize;
+    return q;
+}
+
+static void rec_destroy(void *p) {
+    struct rec_queue *q = p;
+    free(q->kfifo.data);
+    free(q);
+}
+
+static unsigned int kfifo_rec_in(void *p, const void *buf, unsigned int n) {
+    struct rec_queue *q = p;
+    (void)n;
+    return __kfifo_in_r(&q->kfifo, buf, q->len, q->recsize) ? 1 : 0;
+}
+
+static unsigned int kfifo_rec_out(void *p, void *buf, unsigned int n) {
+    struct rec_queue *q = p;
+    (void)n;
+    return __kfifo_out_r(&q->kfifo, buf, q->len, q->recsize) ? 1 : 0;
+}
+
+static unsigned int ringbuf_rec_in(void *p, const void *buf, unsigned int n) {
+    struct rec_queue *q = p;
+    (void)n;
+    return ringbuf_in_rec(&q->ringbuf, buf, q->len, q->recsize) ? 1 : 0;
+}
+
+static unsigned int ringbuf_rec_out(void *p, void *buf, unsigned int n) {
+    struct rec_queue *q = p;
+    (void)n;
+    return ringbuf_out_rec(&q->ringbuf, buf, q->len, q->recsize) ? 1 : 0;
+}
+
+static const struct spsc_ops kfifo_rec_ops = { rec_create, kfifo_rec_in, kfifo_rec_out, rec_destroy };
+static const struct spsc_ops ringbuf_rec_ops = { rec_create, ringbuf_rec_in, ringbuf_rec_out, rec_destroy };
+
+static void rec_sweep(const char *name, const struct spsc_ops *ops,
+    const unsigned int *recsizes, size_t nr_recsizes) {
+    static const unsigned int lens[] = { 8, 64, 200 };
+    char extra[32];
+    size_t r, l;
+
+    for (r = 0; r < nr_recsizes; r++) {
+        rec_recsize = recsizes[r];
+        snprintf(extra, sizeof(extra), "recsize=%u,", recsizes[r]);
+        for (l = 0; l < ARRAY_SIZE(lens); l++)
+            spsc_point(name, extra, ops, 65536, lens[l], 1, bench_scaled((4ul << 20) / lens[l]));
+    }
+}
+
+void bench_kfifo_rec(void) {
+    static const unsigned int recsizes[] = { 1, 2 };
+    rec_sweep("kfifo_rec", &kfifo_rec_ops, recsizes, ARRAY_SIZE(recsizes));
+}
+
+void bench_ringbuf_rec(void) {
+    static const unsigned int recsizes[] = { 1, 2, 4 };
+    rec_sweep("ringbuf_rec", &ringbuf_rec_ops, recsizes, ARRAY_SIZE(recsizes));
+}
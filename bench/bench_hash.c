@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../hashtable.h"
+
+// hashtable.h lookups at fixed load factors (max_load 0, the table never
+// resizes), and inserts into a growing table with per-insert latency, to
+// show that incremental rehashing has no stop-the-world step.
+
+struct hash_obj {
+    unsigned long value;
+    struct hash_node hnode;
+};
+
+static struct hash_obj *hash_find(struct hashtable *ht, unsigned long key) {
+    struct hash_obj *obj;
+
+    hash_for_each_possible(ht, obj, hnode, key) {
+        if (obj->hnode.key == key)
+            return obj;
+    }
+    return NULL;
+}
+
+void bench_hash_lookup(void) {
+    static const double loads[] = { 0.5, 1, 2, 4, 8 };
+    const unsigned int bits = 16;
+    size_t l;
+
+    for (l = 0; l < ARRAY_SIZE(loads); l++) {
+        unsigned long n = (unsigned long)(loads[l] * (1ul << bits));
+        unsigned long lookups = bench_scaled(4000000), i, seed = 1, found = 0;
+        struct hash_obj *objs = malloc(n * sizeof(*objs));
+        struct hashtable ht;
+        unsigned long long t;
+        char params[64];
+
+        if (!objs || hash_init(&ht, bits))
+            abort();
+        ht.max_load = 0;
+        for (i = 0; i < n; i++) {
+            objs[i].value = i;
+            hash_add(&ht, &objs[i].hnode, i * 7919);
+        }
+
+        t = bench_now_ns();
+        for (i = 0; i < lookups; i++) {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            found += hash_find(&ht, ((seed >> 33) % n) * 7919) != NULL;
+        }
+        t = bench_now_ns() - t;
+        if (found != lookups)
+            abort();
+
+        snprintf(params, sizeof(params), "load=%.1f,entries=%lu", loads[l], n);
+        bench_report("hash_lookup", params, (double)lookups, t / 1e9, NULL);
+        hash_exit(&ht);
+        free(objs);
+    }
+}
+
+void bench_hash_insert(void) {
+    unsigned long n = bench_scaled(1000000), i;
+    struct hash_obj *objs = malloc(n * sizeof(*objs));
+    unsigned long long *samples = malloc(n * sizeof(*samples));
+    unsigned long long t, t0;
+    struct hashtable ht;
+    struct bench_lat lat;
+
+    if (!objs || !samples || hash_init(&ht, HASH_MIN_BITS))
+        abort();
+    t = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        t0 = bench_now_ns();
+        hash_add(&ht, &objs[i].hnode, i);
+        samples[i] = bench_now_ns() - t0;
+    }
+    t = bench_now_ns() - t;
+
+    bench_percentiles(samples, n, &lat);
+    bench_report("hash_insert", "max_load=1,grow=incremental", (double)n, t / 1e9, &lat);
+    hash_exit(&ht);
+    free(samples);
+    free(objs);
+}
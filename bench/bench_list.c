@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../list.h"
+#include "../list_sort.h"
+
+// list.h insertion and traversal costs.
+//
+// Traversal walks lists whose nodes are linked either in allocation order
+// (sequential memory access) or in a random permutation (one cache miss per
+// hop once the list is larger than the caches).
+//
+// Sorting compares list_sort() with what callers did before it: copy the
+// node pointers to an array, qsort() it and relink the list in that order.
+//
+// Prefetching walks a list and an hlist of 1M cold 128-byte entries in random
+// order, larger than the last-level cache, and reads the entry's first cache
+// line while the links are in the second. distance=0 is the plain iterator,
+// the others are __list_for_each_entry_prefetch() and its hlist variant.
+
+struct bench_node {
+    unsigned long value;
+    struct list_head list;
+    char pad[40];
+};
+
+static const unsigned long list_sizes[] = { 1000, 64 * 1024, 1024 * 1024 };
+
+static void shuffle(unsigned long *idx, unsigned long n) {
+    unsigned long i, j, t;
+    for (i = 0; i < n; i++)
+        idx[i] = i;
+    for (i = n - 1; i > 0; i--) {
+        j = (unsigned long)rand() % (i + 1);
+        t = idx[i];
+        idx[i] = idx[j];
+        idx[j] = t;
+    }
+}
+
+// link nodes[idx[0]], nodes[idx[1]], ... into head, idx NULL: in order
+static void build_list(struct list_head *head, struct bench_node *nodes,
+    const unsigned long *idx, unsigned long n) {
+    unsigned long i;
+
+    INIT_LIST_HEAD(head);
+    for (i = 0; i < n; i++) {
+        struct bench_node *node = &nodes[idx ? idx[i] : i];
+        node->value = i;
+        list_add_tail(&node->list, head);
+    }
+}
+
+void bench_list_insert(void) {
+    size_t s;
+    char params[64];
+
+    for (s = 0; s < ARRAY_SIZE(list_sizes); s++) {
+        unsigned long n = list_sizes[s], rounds, r, i;
+        struct bench_node *nodes = malloc(n * sizeof(*nodes));
+        struct list_head head;
+        unsigned long long t, add = 0, add_tail = 0;
+
+        rounds = bench_scaled((16ul << 20) / n);
+        for (r = 0; r < rounds; r++) {
+            INIT_LIST_HEAD(&head);
+            t = bench_now_ns();
+            for (i = 0; i < n; i++)
+                list_add_tail(&nodes[i].list, &head);
+            add_tail += bench_now_ns() - t;
+
+            INIT_LIST_HEAD(&head);
+            t = bench_now_ns();
+            for (i = 0; i < n; i++)
+                list_add(&nodes[i].list, &head);
+            add += bench_now_ns() - t;
+        }
+
+        snprintf(params, sizeof(params), "op=list_add_tail,nodes=%lu", n);
+        bench_report("list_insert", params, (double)n * rounds, add_tail / 1e9, NULL);
+        snprintf(params, sizeof(params), "op=list_add,nodes=%lu", n);
+        bench_report("list_insert", params, (double)n * rounds, add / 1e9, NULL);
+        free(nodes);
+    }
+}
+
+void bench_list_traverse(void) {
+    size_t s;
+    int random;
+    char params[64];
+
+    srand(1);
+    for (s = 0; s < ARRAY_SIZE(list_sizes); s++) {
+        unsigned long n = list_sizes[s], rounds, r;
+        struct bench_node *nodes = malloc(n * sizeof(*nodes));
+        unsigned long *idx = malloc(n * sizeof(*idx));
+        volatile unsigned long sink = 0;
+
+        shuffle(idx, n);
+        for (random = 0; random < 2; random++) {
+            struct list_head head;
+            struct bench_node *pos;
+            unsigned long long t;
+
+            build_list(&head, nodes, random ? idx : NULL, n);
+            rounds = bench_scaled((16ul << 20) / n);
+            t = bench_now_ns();
+            for (r = 0; r < rounds; r++) {
+                unsigned long sum = 0;
+                list_for_each_entry(pos, &head, list)
+                    sum += pos->value;
+                sink += sum;
+            }
+            t = bench_now_ns() - t;
+
+            snprintf(params, sizeof(params), "order=%s,nodes=%lu",
+                random ? "random" : "sequential", n);
+            bench_report("list_traverse", params, (double)n * rounds, t / 1e9, NULL);
+        }
+        free(idx);
+        free(nodes);
+    }
+}
+
+static int sort_cmp_list(void *priv, const struct list_head *a, const struct list_head *b) {
+    (void)priv;
+    return list_entry(a, struct bench_node, list)->value >
+        list_entry(b, struct bench_node, list)->value;
+}
+
+static int sort_cmp_array(const void *a, const void *b) {
+    const struct bench_node *x = *(struct bench_node *const *)a;
+    const struct bench_node *y = *(struct bench_node *const *)b;
+
+    return x->value < y->value ? -1 : x->value > y->value;
+}
+
+static void sort_via_array(struct list_head *head, struct bench_node **array) {
+    struct bench_node *pos;
+    unsigned long i = 0, n;
+
+    list_for_each_entry(pos, head, list)
+        array[i++] = pos;
+    n = i;
+    qsort(array, n, sizeof(*array), sort_cmp_array);
+    INIT_LIST_HEAD(head);
+    for (i = 0; i < n; i++)
+        list_add_tail(&array[i]->list, head);
+}
+
+void bench_list_sort(void) {
+    static const unsigned long sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+    size_t s;
+    int use_qsort;
+    char params[64];
+
+    for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+        unsigned long n = sizes[s], rounds, r, i;
+        struct bench_node *nodes = malloc(n * sizeof(*nodes));
+        struct bench_node **array = malloc(n * sizeof(*array));
+
+        if (!nodes || !array)
+            abort();
+        rounds = bench_scaled((4ul << 20) / n);
+        for (use_qsort = 0; use_qsort < 2; use_qsort++) {
+            unsigned long long t = 0, t0;
+            struct list_head head;
+
+            srand(1);
+            for (r = 0; r < rounds; r++) {
+                build_list(&head, nodes, NULL, n);
+                for (i = 0; i < n; i++)
+                    nodes[i].value = (unsigned long)rand();
+                t0 = bench_now_ns();
+                if (use_qsort)
+                    sort_via_array(&head, array);
+                else
+                    list_sort(NULL, &head, sort_cmp_list);
+                t += bench_now_ns() - t0;
+            }
+
+            snprintf(params, sizeof(params), "sort=%s,nodes=%lu",
+                use_qsort ? "qsort_array" : "list_sort", n);
+            bench_report("list_sort", params, (double)n * rounds, t / 1e9, NULL);
+        }
+        free(array);
+        free(nodes);
+    }
+}
+
+struct prefetch_node {
+    unsigned long value[8];
+    struct list_head list;
+    struct hlist_node hnode;
+} __attribute__((aligned(64)));
+
+#define PREFETCH_NODES (1024 * 1024)
+
+static unsigned long prefetch_sum(const struct prefetch_node *pos) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        sum += pos->value[i];
+    return sum;
+}
+
+void bench_list_prefetch(void) {
+    static const unsigned int distances[] = { 0, 1, 2, 4, 8, 16 };
+    unsigned long n = PREFETCH_NODES, rounds = bench_scaled(4), r, i;
+    struct prefetch_node *nodes, *pos;
+    unsigned long *idx = malloc(n * sizeof(*idx));
+    volatile unsigned long sink = 0;
+    struct list_head head, *ahead;
+    struct hlist_head hhead = HLIST_HEAD_INIT;
+    struct hlist_node *hahead;
+    char params[64];
+    size_t d;
+    int hlist;
+
+    if (!idx || posix_memalign((void **)&nodes, 64, n * sizeof(*nodes)))
+        abort();
+    srand(1);
+    shuffle(idx, n);
+    INIT_LIST_HEAD(&head);
+    for (i = 0; i < n; i++) {
+        pos = &nodes[idx[i]];
+        pos->value[0] = i;
+        list_add_tail(&pos->list, &head);
+        hlist_add_head(&pos->hnode, &hhead);
+    }
+
+    for (hlist = 0; hlist < 2; hlist++) {
+        for (d = 0; d < ARRAY_SIZE(distances); d++) {
+            unsigned int dist = distances[d];
+            unsigned long long t;
+
+            t = bench_now_ns();
+            for (r = 0; r < rounds; r++) {
+                unsigned long sum = 0;
+
+                if (hlist && dist) {
+                    __hlist_for_each_entry_prefetch(pos, hahead, &hhead, hnode, dist)
+                        sum += prefetch_sum(pos);
+                } else if (hlist) {
+                    hlist_for_each_entry(pos, &hhead, hnode)
+                        sum += prefetch_sum(pos);
+                } else if (dist) {
+                    __list_for_each_entry_prefetch(pos, ahead, &head, list, dist)
+                        sum += prefetch_sum(pos);
+                } else {
+                    list_for_each_entry(pos, &head, list)
+                        sum += prefetch_sum(pos);
+                }
+                sink += sum;
+            }
+            t = bench_now_ns() - t;
+
+            snprintf(params, sizeof(params), "list=%s,distance=%u,nodes=%lu",
+                hlist ? "hlist" : "list", dist, n);
+            bench_report("list_prefetch", params, (double)n * rounds, t / 1e9, NULL);
+        }
+    }
+    free(idx);
+    free(nodes);
+}
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../list.h"
+#include "../llist.h"
+
+// Multi-producer handoff to one consumer: every producer pushes its share of
+// the items, the consumer takes whatever is there and walks it in FIFO order.
+// "mutex" is list_add_tail() under a pthread_mutex_t and a list_splice_init()
+// by the consumer, "llist" is one llist_add() per item, "llist_batch" links
+// LLIST_BATCH items privately and publishes them with one llist_add_batch().
+// The consumer of both llist variants does llist_del_all() and
+// llist_reverse_order().
+
+#define LLIST_BATCH 16
+#define LLIST_MAX_PRODUCERS 64
+
+enum { LLIST_MUTEX, LLIST_ADD, LLIST_ADD_BATCH };
+
+static const char *const llist_mode_name[] = { "mutex", "llist", "llist_batch" };
+
+struct llist_item {
+    struct llist_node lnode;
+    struct list_head node;
+};
+
+struct llist_run {
+    int mode;
+    struct llist_item *items;
+    unsigned long per_producer;
+    struct llist_head lhead;
+    struct list_head head;
+    pthread_mutex_t lock;
+};
+
+struct llist_producer {
+    struct llist_run *run;
+    struct llist_item *items;
+};
+
+static void *llist_producer_fn(void *arg) {
+    struct llist_producer *p = arg;
+    struct llist_run *run = p->run;
+    unsigned long i, j, n = run->per_producer;
+
+    switch (run->mode) {
+    case LLIST_MUTEX:
+        for (i = 0; i < n; i++) {
+            pthread_mutex_lock(&run->lock);
+            list_add_tail(&p->items[i].node, &run->head);
+            pthread_mutex_unlock(&run->lock);
+        }
+        break;
+    case LLIST_ADD:
+        for (i = 0; i < n; i++)
+            llist_add(&p->items[i].lnode, &run->lhead);
+        break;
+    case LLIST_ADD_BATCH:
+        for (i = 0; i < n; i += LLIST_BATCH) {
+            unsigned long last = i + LLIST_BATCH < n ? i + LLIST_BATCH - 1 : n - 1;
+
+            // newest first, like a run of llist_add()
+            for (j = i; j < last; j++)
+                p->items[j + 1].lnode.next = &p->items[j].lnode;
+            llist_add_batch(&p->items[last].lnode, &p->items[i].lnode, &run->lhead);
+        }
+        break;
+    }
+    return NULL;
+}
+
+// take everything published so far, return the number of items
+static unsigned long llist_consume(struct llist_run *run) {
+    struct llist_item *pos, *n;
+    struct llist_node *first;
+    unsigned long cnt = 0;
+    LIST_HEAD(local);
+
+    if (run->mode == LLIST_MUTEX) {
+        pthread_mutex_lock(&run->lock);
+        list_splice_init(&run->head, &local);
+        pthread_mutex_unlock(&run->lock);
+        list_for_each_entry_safe(pos, n, &local, node)
+            cnt++;
+    } else {
+        first = llist_reverse_order(llist_del_all(&run->lhead));
+        llist_for_each_entry_safe(pos, n, first, lnode)
+            cnt++;
+    }
+    return cnt;
+}
+
+void bench_llist_mpsc(void) {
+    static const unsigned int producers[] = { 1, 4, 16, 64 };
+    unsigned long total = bench_scaled(4000000);
+    size_t p;
+    int mode;
+
+    for (p = 0; p < ARRAY_SIZE(producers); p++) {
+        for (mode = LLIST_MUTEX; mode <= LLIST_ADD_BATCH; mode++) {
+            struct llist_run run;
+            struct llist_producer prod[LLIST_MAX_PRODUCERS];
+            pthread_t threads[LLIST_MAX_PRODUCERS];
+            unsigned long long t;
+            unsigned long done = 0, want;
+            unsigned int i, spins = 0;
+            char params[64];
+
+            run.mode = mode;
+            run.per_producer = total / producers[p];
+            want = run.per_producer * producers[p];
+            run.items = malloc(want * sizeof(*run.items));
+            if (!run.items)
+                abort();
+            init_llist_head(&run.lhead);
+            INIT_LIST_HEAD(&run.head);
+            pthread_mutex_init(&run.lock, NULL);
+
+            bench_pin(0);
+            t = bench_now_ns();
+            for (i = 0; i < producers[p]; i++) {
+                prod[i].run = &run;
+                prod[i].items = run.items + i * run.per_producer;
+                pthread_create(&threads[i], NULL, llist_producer_fn, &prod[i]);
+            }
+            while (done < want) {
+                unsigned long n = llist_consume(&run);
+
+                done += n;
+                if (!n)
+                    bench_relax(&spins);
+                else
+                    spins = 0;
+            }
+            t = bench_now_ns() - t;
+            for (i = 0; i < producers[p]; i++)
+                pthread_join(threads[i], NULL);
+
+            pthread_mutex_destroy(&run.lock);
+            free(run.items);
+
+            snprintf(params, sizeof(params), "sync=%s,producers=%u",
+                llist_mode_name[mode], producers[p]);
+            bench_report("llist_mpsc", params, (double)want, t / 1e9, NULL);
+        }
+    }
+}
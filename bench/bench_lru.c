@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../lru_cache.h"
+#include "../hashtable.h"
+
+// Object cache hit path and eviction.
+//
+// "global" is the classic LRU: one mutex around a hashtable, a hit does
+// list_move_tail() and eviction drops the oldest entry one at a time.
+// "clock" is lru_cache with 16 shards: a hit is an RCU bucket walk that sets
+// a bit, eviction cuts a batch of victims off the shard's list.
+//
+// lru_hit: 64k resident entries, 1 to 8 threads look up random keys.
+// lru_evict: one thread inserts keys cycling over 4x what fits, so nearly
+// every insert has to make room.
+
+#define LRU_ENTRIES (64 * 1024)
+#define LRU_OBJ_SIZE 64
+#define LRU_MAX_THREADS 8
+
+struct lru_obj {
+    struct lru_entry entry;       // clock
+    struct hash_node hnode;       // global
+    struct list_head lru;         // global
+};
+
+struct lru_global {
+    pthread_mutex_t lock;
+    struct hashtable ht;
+    struct list_head lru;         // oldest first
+    size_t bytes;
+    size_t capacity;
+};
+
+struct lru_run {
+    int clock;
+    struct lru_cache cache;
+    struct lru_global global;
+    struct lru_obj *objs;
+    unsigned long lookups;        // per thread
+};
+
+static void lru_global_init(struct lru_global *g, size_t capacity) {
+    pthread_mutex_init(&g->lock, NULL);
+    hash_init(&g->ht, 10);
+    INIT_LIST_HEAD(&g->lru);
+    g->bytes = 0;
+    g->capacity = capacity;
+}
+
+static void lru_global_exit(struct lru_global *g) {
+    hash_exit(&g->ht);
+    pthread_mutex_destroy(&g->lock);
+}
+
+static struct lru_obj *lru_global_lookup(struct lru_global *g, unsigned long key) {
+    struct lru_obj *obj;
+
+    pthread_mutex_lock(&g->lock);
+    hash_for_each_possible(&g->ht, obj, hnode, key) {
+        if (obj->hnode.key == key) {
+            list_move_tail(&obj->lru, &g->lru);
+            pthread_mutex_unlock(&g->lock);
+            return obj;
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+static void lru_global_insert(struct lru_global *g, struct lru_obj *obj, unsigned long key) {
+    struct lru_obj *old;
+
+    pthread_mutex_lock(&g->lock);
+    hash_add(&g->ht, &obj->hnode, key);
+    list_add_tail(&obj->lru, &g->lru);
+    g->bytes += LRU_OBJ_SIZE;
+    while (g->bytes > g->capacity) {
+        old = list_first_entry(&g->lru, struct lru_obj, lru);
+        hash_del(&g->ht, &old->hnode);
+        list_del_init(&old->lru);
+        g->bytes -= LRU_OBJ_SIZE;
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+static void lru_global_del(struct lru_global *g, struct lru_obj *obj) {
+    pthread_mutex_lock(&g->lock);
+    if (hash_hashed(&obj->hnode)) {
+        hash_del(&g->ht, &obj->hnode);
+        list_del_init(&obj->lru);
+        g->bytes -= LRU_OBJ_SIZE;
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+static void lru_run_init(struct lru_run *run, int clock, size_t capacity) {
+    unsigned long i;
+
+    run->clock = clock;
+    run->objs = malloc(LRU_ENTRIES * 4 * sizeof(*run->objs));
+    if (!run->objs)
+        abort();
+    for (i = 0; i < LRU_ENTRIES * 4; i++) {
+        INIT_HLIST_NODE(&run->objs[i].entry.hnode);
+        INIT_HLIST_NODE(&run->objs[i].hnode.node);
+        INIT_LIST_HEAD(&run->objs[i].lru);
+    }
+    if (clock) {
+        // the entries are reused in place, nothing to free on eviction
+        if (lru_cache_init(&run->cache, capacity, 16, capacity / LRU_OBJ_SIZE, NULL, NULL))
+            abort();
+    } else {
+        lru_global_init(&run->global, capacity);
+    }
+}
+
+static void lru_run_exit(struct lru_run *run) {
+    if (run->clock)
+        lru_cache_exit(&run->cache);
+    else
+        lru_global_exit(&run->global);
+    free(run->objs);
+}
+
+static void lru_run_insert(struct lru_run *run, unsigned long key) {
+    struct lru_obj *obj = &run->objs[key % (LRU_ENTRIES * 4)];
+
+    if (run->clock) {
+        if (!hlist_unhashed(&obj->entry.hnode))
+            lru_cache_del(&run->cache, &obj->entry);
+        lru_cache_insert(&run->cache, &obj->entry, key, LRU_OBJ_SIZE);
+    } else {
+        lru_global_del(&run->global, obj);
+        lru_global_insert(&run->global, obj, key);
+    }
+}
+
+static void *lru_reader_fn(void *arg) {
+    struct lru_run *run = arg;
+    unsigned long i, key, found = 0;
+    unsigned long long x = (unsigned long long)(size_t)&i | 1;
+
+    if (run->clock)
+        rcu_register_thread();
+    for (i = 0; i < run->lookups; i++) {
+        // xorshift, rand() would serialize the threads on its own lock
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        key = x % LRU_ENTRIES;
+        if (run->clock) {
+            rcu_read_lock();
+            found += lru_cache_lookup(&run->cache, key) != NULL;
+            rcu_read_unlock();
+        } else {
+            found += lru_global_lookup(&run->global, key) != NULL;
+        }
+    }
+    if (run->clock)
+        rcu_unregister_thread();
+    if (found != run->lookups)
+        abort();
+    return NULL;
+}
+
+void bench_lru_hit(void) {
+    static const unsigned int threads[] = { 1, 2, 4, 8 };
+    unsigned long lookups = bench_scaled(4000000), i;
+    size_t t;
+    int clock;
+
+    for (t = 0; t < ARRAY_SIZE(threads); t++) {
+        for (clock = 0; clock < 2; clock++) {
+            struct lru_run run;
+            pthread_t tid[LRU_MAX_THREADS];
+            unsigned long long ns;
+            char params[64];
+
+            // twice the room, nothing gets evicted
+            lru_run_init(&run, clock, 2ul * LRU_ENTRIES * LRU_OBJ_SIZE);
+            for (i = 0; i < LRU_ENTRIES; i++)
+                lru_run_insert(&run, i);
+            run.lookups = lookups / threads[t];
+
+            ns = bench_now_ns();
+            for (i = 0; i < threads[t]; i++)
+                pthread_create(&tid[i], NULL, lru_reader_fn, &run);
+            for (i = 0; i < threads[t]; i++)
+                pthread_join(tid[i], NULL);
+            ns = bench_now_ns() - ns;
+            lru_run_exit(&run);
+
+            snprintf(params, sizeof(params), "lru=%s,threads=%u",
+                clock ? "clock" : "global", threads[t]);
+            bench_report("lru_hit", params, (double)run.lookups * threads[t], ns / 1e9, NULL);
+        }
+    }
+}
+
+void bench_lru_evict(void) {
+    unsigned long inserts = bench_scaled(4000000), i;
+    int clock;
+
+    for (clock = 0; clock < 2; clock++) {
+        struct lru_run run;
+        unsigned long long ns;
+        char params[64];
+
+        lru_run_init(&run, clock, (size_t)LRU_ENTRIES * LRU_OBJ_SIZE);
+        ns = bench_now_ns();
+        for (i = 0; i < inserts; i++)
+            lru_run_insert(&run, i);
+        ns = bench_now_ns() - ns;
+        lru_run_exit(&run);
+
+        snprintf(params, sizeof(params), "lru=%s,entries=%u",
+            clock ? "clock" : "global", LRU_ENTRIES);
+        bench_report("lru_evict", params, (double)inserts, ns / 1e9, NULL);
+    }
+}
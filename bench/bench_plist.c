@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../plist.h"
+
+// Priority-ordered wait queue with few distinct priorities and many waiters:
+// every operation wakes the first waiter and queues it again with a random
+// priority, FIFO among equal priorities.
+// "list" walks a sorted list_head to the end of the waiter's priority,
+// "plist" walks plist's prio_list, one node per distinct priority.
+
+struct waiter {
+    int prio;
+    struct list_head list;
+    struct plist_node pnode;
+};
+
+static void sorted_waiter_add(struct waiter *w, struct list_head *head) {
+    struct waiter *pos;
+
+    list_for_each_entry(pos, head, list) {
+        if (pos->prio > w->prio)
+            break;
+    }
+    list_add_tail(&w->list, &pos->list);
+}
+
+void bench_plist_waitq(void) {
+    static const unsigned int prios[] = { 4, 32 };
+    static const unsigned long waiters[] = { 1024, 16 * 1024 };
+    unsigned long ops = bench_scaled(1ul << 20);
+    size_t p, n;
+    int use_plist;
+
+    for (n = 0; n < ARRAY_SIZE(waiters); n++) {
+        for (p = 0; p < ARRAY_SIZE(prios); p++) {
+            for (use_plist = 0; use_plist < 2; use_plist++) {
+                struct waiter *ws = malloc(waiters[n] * sizeof(*ws)), *w;
+                // the list walks most of the waiters per operation, keep its runs short
+                unsigned long i, run = use_plist ? ops : ops / (waiters[n] / 64);
+                unsigned long long t;
+                PLIST_HEAD(phead);
+                LIST_HEAD(head);
+                char params[64];
+
+                srand(1);
+                for (i = 0; i < waiters[n]; i++) {
+                    ws[i].prio = rand() % prios[p];
+                    plist_node_init(&ws[i].pnode, ws[i].prio);
+                    if (use_plist)
+                        plist_add(&ws[i].pnode, &phead);
+                    else
+                        sorted_waiter_add(&ws[i], &head);
+                }
+
+                t = bench_now_ns();
+                for (i = 0; i < run; i++) {
+                    if (use_plist) {
+                        w = plist_first_entry(&phead, struct waiter, pnode);
+                        plist_del(&w->pnode, &phead);
+                        w->pnode.prio = rand() % prios[p];
+                        plist_add(&w->pnode, &phead);
+                    } else {
+                        w = list_first_entry(&head, struct waiter, list);
+                        list_del(&w->list);
+                        w->prio = rand() % prios[p];
+                        sorted_waiter_add(w, &head);
+                    }
+                }
+                t = bench_now_ns() - t;
+                free(ws);
+
+                snprintf(params, sizeof(params), "queue=%s,waiters=%lu,prios=%u",
+                    use_plist ? "plist" : "list", waiters[n], prios[p]);
+                bench_report("plist_waitq", params, (double)run, t / 1e9, NULL);
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../kfifo_prio.h"
+
+// Priority queue put/get cost against the number of levels, single thread.
+// Each round puts 64 elements on pseudo-random levels and takes them all
+// back. "bitmap" is kfifo_prio_out(), "scan" walks the level kfifos from the
+// top until it finds a non-empty one (the puts still pay for the bitmap),
+// "weighted" is kfifo_prio_out_weighted().
+
+#define PRIO_ROUND 64
+
+static unsigned int prio_scan(struct kfifo_prio *pq, unsigned long *v) {
+    unsigned int l;
+
+    for (l = 0; l < pq->nr; l++) {
+        if (pq->level[l].in != pq->level[l].out)
+            return __kfifo_out(&pq->level[l], v, 1);
+    }
+    return 0;
+}
+
+void bench_kfifo_prio(void) {
+    static const unsigned int levels[] = { 8, 64, 1024, 4096 };
+    static const char *const modes[] = { "bitmap", "scan", "weighted" };
+    unsigned long rounds = bench_scaled(50000);
+    size_t l, m;
+
+    for (l = 0; l < ARRAY_SIZE(levels); l++) {
+        for (m = 0; m < ARRAY_SIZE(modes); m++) {
+            struct kfifo_prio pq;
+            unsigned long r, v = 0, seed = 1;
+            unsigned long long t;
+            unsigned int i, lv;
+            char params[64];
+
+            if (kfifo_prio_alloc(&pq, levels[l], PRIO_ROUND, sizeof(long)))
+                abort();
+            t = bench_now_ns();
+            for (r = 0; r < rounds; r++) {
+                for (i = 0; i < PRIO_ROUND; i++) {
+                    seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+                    kfifo_prio_in(&pq, (seed >> 33) % levels[l], &v, 1);
+                }
+                for (i = 0; i < PRIO_ROUND; i++) {
+                    if (m == 0)
+                        kfifo_prio_out(&pq, &v, 1, &lv);
+                    else if (m == 1)
+                        prio_scan(&pq, &v);
+                    else
+                        kfifo_prio_out_weighted(&pq, &v, 1, &lv);
+                }
+            }
+            t = bench_now_ns() - t;
+            kfifo_prio_free(&pq);
+
+            snprintf(params, sizeof(params), "levels=%u,get=%s", levels[l], modes[m]);
+            bench_report("kfifo_prio", params, (double)rounds * PRIO_ROUND, t / 1e9, NULL);
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../list.h"
+#include "../rbtree.h"
+
+// Ordered queue in the "hold" model of timers and order books: the queue
+// keeps n entries, every operation takes the smallest one and puts it back
+// with a new, later key.
+// "list" inserts by walking a sorted list_head from the front (what the
+// timer code did), "rbtree" uses rb_add_cached() and rb_erase_cached(), so
+// the minimum is rb_first_cached().
+
+struct hold_entry {
+    unsigned long key;
+    struct rb_node rb;
+    struct list_head list;
+};
+
+static const unsigned long rbtree_sizes[] = { 64, 1024, 16 * 1024, 256 * 1024 };
+
+static bool hold_entry_less(struct rb_node *a, const struct rb_node *b) {
+    return rb_entry(a, struct hold_entry, rb)->key < rb_entry(b, struct hold_entry, rb)->key;
+}
+
+static void sorted_list_add(struct hold_entry *e, struct list_head *head) {
+    struct hold_entry *pos;
+
+    list_for_each_entry(pos, head, list) {
+        if (pos->key > e->key)
+            break;
+    }
+    list_add_tail(&e->list, &pos->list);
+}
+
+// later key for an entry that was just taken at @now
+static unsigned long rbtree_next_key(unsigned long now, unsigned long n) {
+    return now + 1 + (unsigned long)rand() % (2 * n);
+}
+
+void bench_rbtree_hold(void) {
+    size_t s;
+    int use_rb;
+
+    for (s = 0; s < ARRAY_SIZE(rbtree_sizes); s++) {
+        unsigned long n = rbtree_sizes[s];
+
+        for (use_rb = 0; use_rb < 2; use_rb++) {
+            struct hold_entry *entries, *e;
+            struct rb_root_cached root = RB_ROOT_CACHED;
+            unsigned long i, ops, sum = 0;
+            unsigned long long t;
+            LIST_HEAD(head);
+            char params[64];
+
+            // the list walks n / 2 entries per insert, keep its runs short
+            if (use_rb)
+                ops = bench_scaled(1ul << 21);
+            else if (n > 16 * 1024)
+                continue;
+            else
+                ops = bench_scaled((1ul << 26) / n);
+            entries = malloc(n * sizeof(*entries));
+
+            srand(1);
+            for (i = 0; i < n; i++) {
+                entries[i].key = rbtree_next_key(0, n);
+                if (use_rb)
+                    rb_add_cached(&entries[i].rb, &root, hold_entry_less);
+                else
+                    sorted_list_add(&entries[i], &head);
+            }
+
+            t = bench_now_ns();
+            for (i = 0; i < ops; i++) {
+                if (use_rb) {
+                    e = rb_entry(rb_first_cached(&root), struct hold_entry, rb);
+                    rb_erase_cached(&e->rb, &root);
+                    e->key = rbtree_next_key(e->key, n);
+                    rb_add_cached(&e->rb, &root, hold_entry_less);
+                } else {
+                    e = list_first_entry(&head, struct hold_entry, list);
+                    list_del(&e->list);
+                    e->key = rbtree_next_key(e->key, n);
+                    sorted_list_add(e, &head);
+                }
+                sum += e->key;
+            }
+            t = bench_now_ns() - t;
+            if (!sum)
+                abort();
+            free(entries);
+
+            snprintf(params, sizeof(params), "queue=%s,entries=%lu",
+                use_rb ? "rbtree" : "list", n);
+            bench_report("rbtree_hold", params, (double)ops, t / 1e9, NULL);
+        }
+    }
+}
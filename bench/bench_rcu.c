@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include "bench.h"
+#include "../rculist.h"
+
+// Read-mostly list: reader threads look up keys in a 64-entry list while a
+// writer replaces one entry about every 10 us.
+// "rwlock" takes a pthread_rwlock_t around every lookup, "rcu" uses
+// rcu_read_lock() and list_for_each_entry_rcu(), and frees with call_rcu().
+
+#define RCU_ENTRIES 64
+#define RCU_MAX_READERS 8
+
+struct rcu_entry {
+    unsigned long key;
+    struct list_head list;
+    struct rcu_head rcu;
+};
+
+struct rcu_run {
+    int use_rcu;
+    unsigned long lookups;    // per reader
+    struct list_head head;
+    pthread_rwlock_t rwlock;
+    pthread_mutex_t wlock;
+    int stop;
+};
+
+static void rcu_entry_free(struct rcu_head *rcu) {
+    free(container_of(rcu, struct rcu_entry, rcu));
+}
+
+static void *rcu_reader_fn(void *arg) {
+    struct rcu_run *run = arg;
+    struct rcu_entry *pos;
+    unsigned long i, found = 0;
+
+    bench_pin(1);
+    if (run->use_rcu)
+        rcu_register_thread();
+    for (i = 0; i < run->lookups; i++) {
+        unsigned long key = i % RCU_ENTRIES;
+
+        if (run->use_rcu) {
+            rcu_read_lock();
+            list_for_each_entry_rcu(pos, &run->head, list) {
+                if (pos->key == key) {
+                    found++;
+                    break;
+                }
+            }
+            rcu_read_unlock();
+        } else {
+            pthread_rwlock_rdlock(&run->rwlock);
+            list_for_each_entry(pos, &run->head, list) {
+                if (pos->key == key) {
+                    found++;
+                    break;
+                }
+            }
+            pthread_rwlock_unlock(&run->rwlock);
+        }
+    }
+    if (run->use_rcu)
+        rcu_unregister_thread();
+    if (found != run->lookups)
+        abort();
+    return NULL;
+}
+
+// replace the first entry by a copy at the tail
+static void rcu_update(struct rcu_run *run) {
+    struct rcu_entry *old, *new = malloc(sizeof(*new));
+
+    if (run->use_rcu) {
+        pthread_mutex_lock(&run->wlock);
+        old = list_first_entry(&run->head, struct rcu_entry, list);
+        new->key = old->key;
+        list_del_rcu(&old->list);
+        list_add_tail_rcu(&new->list, &run->head);
+        pthread_mutex_unlock(&run->wlock);
+        call_rcu(&old->rcu, rcu_entry_free);
+    } else {
+        pthread_rwlock_wrlock(&run->rwlock);
+        old = list_first_entry(&run->head, struct rcu_entry, list);
+        new->key = old->key;
+        list_del(&old->list);
+        list_add_tail(&new->list, &run->head);
+        pthread_rwlock_unlock(&run->rwlock);
+        free(old);
+    }
+}
+
+static void *rcu_writer_fn(void *arg) {
+    struct rcu_run *run = arg;
+    struct timespec pause = { 0, 10000 };
+
+    bench_pin(0);
+    while (!__atomic_load_n(&run->stop, __ATOMIC_ACQUIRE)) {
+        rcu_update(run);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+void bench_rcu_list(void) {
+    static const unsigned int readers[] = { 1, 2, 4, 8 };
+    unsigned long lookups = bench_scaled(2000000);
+    size_t r;
+    int use_rcu;
+
+    for (r = 0; r < ARRAY_SIZE(readers); r++) {
+        for (use_rcu = 0; use_rcu < 2; use_rcu++) {
+            struct rcu_run run;
+            pthread_t threads[RCU_MAX_READERS], writer;
+            struct rcu_entry *pos, *n;
+            unsigned long long t;
+            unsigned int i;
+            char params[64];
+
+            run.use_rcu = use_rcu;
+            run.lookups = lookups / readers[r];
+            run.stop = 0;
+            INIT_LIST_HEAD(&run.head);
+            pthread_rwlock_init(&run.rwlock, NULL);
+            pthread_mutex_init(&run.wlock, NULL);
+            for (i = 0; i < RCU_ENTRIES; i++) {
+                pos = malloc(sizeof(*pos));
+                pos->key = i;
+                list_add_tail(&pos->list, &run.head);
+            }
+
+            t = bench_now_ns();
+            pthread_create(&writer, NULL, rcu_writer_fn, &run);
+            for (i = 0; i < readers[r]; i++)
+                pthread_create(&threads[i], NULL, rcu_reader_fn, &run);
+            for (i = 0; i < readers[r]; i++)
+                pthread_join(threads[i], NULL);
+            t = bench_now_ns() - t;
+            __atomic_store_n(&run.stop, 1, __ATOMIC_RELEASE);
+            pthread_join(writer, NULL);
+            rcu_barrier();
+
+            list_for_each_entry_safe(pos, n, &run.head, list)
+                free(pos);
+            pthread_rwlock_destroy(&run.rwlock);
+            pthread_mutex_destroy(&run.wlock);
+
+            snprintf(params, sizeof(params), "sync=%s,readers=%u",
+                use_rcu ? "rcu" : "rwlock", readers[r]);
+            bench_report("rcu_list", params, (double)run.lookups * readers[r], t / 1e9, NULL);
+        }
+    }
+}
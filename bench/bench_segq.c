@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo_segq.h"
+
+// Unbounded queue throughput: writers never wait, the reader drains
+// concurrently, so the queue depth follows whatever the scheduling gives.
+// Swept over the segment size, with one writer (kfifo_segq_in) and with
+// two writers (kfifo_segq_in_mp).
+
+#define SEGQ_BATCH 32
+
+struct segq_run {
+    struct kfifo_segq q;
+    unsigned long items;    // per writer
+    int mp;
+};
+
+static void *segq_writer(void *arg) {
+    struct segq_run *run = arg;
+    unsigned long buf[SEGQ_BATCH] = { 0 }, i;
+    unsigned int n;
+
+    bench_pin(0);
+    for (i = 0; i < run->items; i += n) {
+        n = run->items - i < SEGQ_BATCH ? run->items - i : SEGQ_BATCH;
+        if (run->mp)
+            n = kfifo_segq_in_mp(&run->q, buf, n);
+        else
+            n = kfifo_segq_in(&run->q, buf, n);
+        if (!n)
+            abort();
+    }
+    return NULL;
+}
+
+void bench_kfifo_segq(void) {
+    static const unsigned int seg_sizes[] = { 64, 1024, 16384 };
+    static const unsigned int writers[] = { 1, 2 };
+    unsigned long items = bench_scaled(4000000);
+    size_t s, w;
+
+    for (w = 0; w < ARRAY_SIZE(writers); w++) {
+        for (s = 0; s < ARRAY_SIZE(seg_sizes); s++) {
+            struct segq_run run;
+            unsigned long buf[SEGQ_BATCH], got = 0, total;
+            unsigned long long t;
+            unsigned int spins = 0, n, i;
+            pthread_t threads[2];
+            char params[64];
+
+            if (kfifo_segq_alloc(&run.q, seg_sizes[s], sizeof(long), 64))
+                abort();
+            run.items = items / writers[w];
+            run.mp = writers[w] > 1;
+            total = run.items * writers[w];
+
+            t = bench_now_ns();
+            for (i = 0; i < writers[w]; i++)
+                pthread_create(&threads[i], NULL, segq_writer, &run);
+            bench_pin(1);
+            while (got < total) {
+                n = kfifo_segq_out(&run.q, buf, SEGQ_BATCH);
+                if (!n)
+                    bench_relax(&spins);
+                got += n;
+            }
+            for (i = 0; i < writers[w]; i++)
+                pthread_join(threads[i], NULL);
+            t = bench_now_ns() - t;
+            kfifo_segq_free(&run.q);
+
+            snprintf(params, sizeof(params), "writers=%u,seg=%u", writers[w], seg_sizes[s]);
+            bench_report("kfifo_segq", params, (double)total, t / 1e9, NULL);
+        }
+    }
+}
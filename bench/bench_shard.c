@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "bench.h"
+#include "../kfifo.h"
+#include "../kfifo_shard.h"
+
+// Producer scaling: P producer threads and one consumer moving 8 byte items
+// through a kfifo_shards set, compared with one __kfifo whose producers
+// serialize on a mutex (the usual MPSC kfifo setup).
+
+#define SHARD_BATCH 16
+
+struct shard_run {
+    int sharded;
+    struct kfifo_shards set;
+    struct __kfifo fifo;
+    pthread_mutex_t lock;
+    unsigned long per_producer;
+    unsigned int producers;
+};
+
+static void *shard_producer(void *arg) {
+    struct shard_run *run = arg;
+    unsigned long long buf[SHARD_BATCH] = { 0 };
+    unsigned long i = 0;
+    unsigned int spins = 0, n;
+
+    bench_pin(0);
+    while (i < run->per_producer) {
+        if (run->sharded) {
+            n = kfifo_shards_in(&run->set, buf, SHARD_BATCH);
+        } else {
+            pthread_mutex_lock(&run->lock);
+            n = __kfifo_in(&run->fifo, buf, SHARD_BATCH);
+            pthread_mutex_unlock(&run->lock);
+        }
+        if (!n)
+            bench_relax(&spins);
+        i += n;
+    }
+    if (run->sharded)
+        kfifo_shards_release(&run->set);
+    return NULL;
+}
+
+static void *shard_consumer(void *arg) {
+    struct shard_run *run = arg;
+    unsigned long long buf[256];
+    unsigned long total = run->per_producer * run->producers, i = 0;
+    unsigned int spins = 0, n;
+
+    bench_pin(1);
+    while (i < total) {
+        if (run->sharded)
+            n = kfifo_shards_out(&run->set, 0, buf, ARRAY_SIZE(buf));
+        else
+            n = __kfifo_out(&run->fifo, buf, ARRAY_SIZE(buf));
+        if (!n)
+            bench_relax(&spins);
+        i += n;
+    }
+    return NULL;
+}
+
+void bench_kfifo_shards(void) {
+    static const unsigned int producers[] = { 1, 2, 4, 8 };
+    size_t p;
+    int sharded;
+
+    for (p = 0; p < ARRAY_SIZE(producers); p++) {
+        for (sharded = 0; sharded < 2; sharded++) {
+            struct shard_run run;
+            pthread_t threads[8], consumer;
+            unsigned long long t;
+            unsigned int i;
+            char params[64];
+
+            run.sharded = sharded;
+            run.producers = producers[p];
+            // a multiple of the batch, so every producer stops exactly
+            run.per_producer = bench_scaled((1ul << 21) / producers[p]) / SHARD_BATCH * SHARD_BATCH;
+            if (!run.per_producer)
+                run.per_producer = SHARD_BATCH;
+            if (sharded)
+                kfifo_shards_alloc(&run.set, producers[p], 4096, 8);
+            else
+                __kfifo_alloc(&run.fifo, 4096 * producers[p], 8);
+            pthread_mutex_init(&run.lock, NULL);
+
+            t = bench_now_ns();
+            pthread_create(&consumer, NULL, shard_consumer, &run);
+            for (i = 0; i < run.producers; i++)
+                pthread_create(&threads[i], NULL, shard_producer, &run);
+            for (i = 0; i < run.producers; i++)
+                pthread_join(threads[i], NULL);
+            pthread_join(consumer, NULL);
+            t = bench_now_ns() - t;
+
+            snprintf(params, sizeof(params), "queue=%s,producers=%u",
+                sharded ? "shards" : "kfifo+mutex", producers[p]);
+            bench_report("kfifo_shards", params, (double)run.per_producer * run.producers, t / 1e9, NULL);
+
+            if (sharded)
+                kfifo_shards_free(&run.set);
+            else
+                __kfifo_free(&run.fifo);
+            pthread_mutex_destroy(&run.lock);
+        }
+    }
+}
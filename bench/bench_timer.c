@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../timer_wheel.h"
+#include "../rbtree.h"
+
+// Connection timeouts: 1M armed timers with timeouts of up to 64k ticks.
+// Every tick, some connections see traffic and push their timeout back
+// (cancel and re-arm), then the clock advances by one and whatever expired
+// is re-armed as a new connection.
+// "wheel" is timer_wheel_mod()/timer_wheel_run(), "rbtree" keeps the timers
+// in an rb_root_cached ordered by expiry and pops rb_first_cached().
+// ops counts re-arms plus expiries.
+
+#define TIMER_COUNT (1ul << 20)
+#define TIMER_SPAN (1ul << 16)
+
+struct bench_timer {
+    struct timer_list timer;
+    struct rb_node rb;
+};
+
+static struct timer_wheel *timer_bench_wheel;
+static unsigned long timer_bench_fired;
+
+static unsigned long timer_timeout(void) {
+    return 1 + (unsigned long)rand() % (TIMER_SPAN - 1);
+}
+
+static void timer_bench_fn(struct timer_list *timer) {
+    timer_bench_fired++;
+    timer_wheel_add(timer_bench_wheel, timer, timer_bench_wheel->clk + timer_timeout());
+}
+
+static bool timer_less(struct rb_node *a, const struct rb_node *b) {
+    return (long)(rb_entry(a, struct bench_timer, rb)->timer.expires -
+        rb_entry(b, struct bench_timer, rb)->timer.expires) < 0;
+}
+
+static void timer_rb_add(struct rb_root_cached *root, struct bench_timer *t,
+    unsigned long expires) {
+    t->timer.expires = expires;
+    rb_add_cached(&t->rb, root, timer_less);
+}
+
+// pop and re-arm everything due at @now, return the number of expiries
+static unsigned long timer_rb_run(struct rb_root_cached *root, unsigned long now) {
+    struct rb_node *first;
+    struct bench_timer *t;
+    unsigned long n = 0;
+
+    while ((first = rb_first_cached(root))) {
+        t = rb_entry(first, struct bench_timer, rb);
+        if ((long)(now - t->timer.expires) < 0)
+            break;
+        rb_erase_cached(first, root);
+        timer_rb_add(root, t, now + 1 + timer_timeout());
+        n++;
+    }
+    return n;
+}
+
+void bench_timer_wheel(void) {
+    static const unsigned int mods_per_tick[] = { 16, 256, 4096 };
+    unsigned long count = bench_scaled(TIMER_COUNT);
+    size_t m;
+    int use_rb;
+
+    for (m = 0; m < ARRAY_SIZE(mods_per_tick); m++) {
+        for (use_rb = 0; use_rb < 2; use_rb++) {
+            struct bench_timer *timers = malloc(count * sizeof(*timers)), *t;
+            struct timer_wheel *wheel = malloc(sizeof(*wheel));
+            struct rb_root_cached root = RB_ROOT_CACHED;
+            unsigned long i, j, ticks, now = 0, ops = 0;
+            unsigned long long start;
+            char params[64];
+
+            if (!timers || !wheel)
+                abort();
+            srand(1);
+            timer_wheel_init(wheel, now);
+            timer_bench_wheel = wheel;
+            timer_bench_fired = 0;
+            for (i = 0; i < count; i++) {
+                timer_setup(&timers[i].timer, timer_bench_fn);
+                if (use_rb)
+                    timer_rb_add(&root, &timers[i], now + timer_timeout());
+                else
+                    timer_wheel_add(wheel, &timers[i].timer, now + timer_timeout());
+            }
+
+            ticks = bench_scaled((1ul << 20) / mods_per_tick[m]);
+            start = bench_now_ns();
+            for (j = 0; j < ticks; j++) {
+                for (i = 0; i < mods_per_tick[m]; i++) {
+                    t = &timers[(unsigned long)rand() % count];
+                    if (use_rb) {
+                        rb_erase_cached(&t->rb, &root);
+                        timer_rb_add(&root, t, now + timer_timeout());
+                    } else {
+                        timer_wheel_mod(wheel, &t->timer, now + timer_timeout());
+                    }
+                }
+                now++;
+                if (use_rb)
+                    ops += timer_rb_run(&root, now);
+                else
+                    timer_wheel_run(wheel, now);
+            }
+            start = bench_now_ns() - start;
+            ops += timer_bench_fired + ticks * mods_per_tick[m];
+
+            free(timers);
+            free(wheel);
+
+            snprintf(params, sizeof(params), "queue=%s,timers=%lu,mods_per_tick=%u",
+                use_rb ? "rbtree" : "wheel", count, mods_per_tick[m]);
+            bench_report("timer_wheel", params, (double)ops, start / 1e9, NULL);
+        }
+    }
+}
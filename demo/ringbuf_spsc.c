@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../kfifo.h"
+#include "../ringbuf.h"
+
+// SPSC demo: one writer and one reader thread moving a sequence of ints
+// through ringbuf_t and struct __kfifo, checking order and timing both.
+
+#define COUNT (1u << 22)
+#define BATCH 16
+#define BUFSIZE 4096
+
+static struct ringbuf_t g_ringbuf;
+static struct __kfifo g_kfifo;
+static unsigned char g_ringbuf_data[BUFSIZE];
+static unsigned char g_kfifo_data[BUFSIZE];
+static int g_errors;
+
+static unsigned int put(int use_kfifo, const int *buf, unsigned int n) {
+    return use_kfifo ? __kfifo_in(&g_kfifo, buf, n) : ringbuf_in(&g_ringbuf, buf, n);
+}
+
+static unsigned int get(int use_kfifo, int *buf, unsigned int n) {
+    return use_kfifo ? __kfifo_out(&g_kfifo, buf, n) : ringbuf_out(&g_ringbuf, buf, n);
+}
+
+void* write_thread(void* arg) {
+    int use_kfifo = *(int*)arg;
+    int buf[BATCH];
+    unsigned int i = 0, j;
+    while (i < COUNT) {
+        for (j = 0; j < BATCH; j++)
+            buf[j] = (int)(i + j);
+        j = 0;
+        while (j < BATCH) {
+            unsigned int n = put(use_kfifo, buf + j, BATCH - j);
+            if (n == 0)
+                sched_yield();
+            j += n;
+        }
+        i += BATCH;
+    }
+    return NULL;
+}
+
+void* read_thread(void* arg) {
+    int use_kfifo = *(int*)arg;
+    int buf[BATCH];
+    unsigned int i = 0, j, n;
+    while (i < COUNT) {
+        n = get(use_kfifo, buf, BATCH);
+        if (n == 0)
+            sched_yield();
+        for (j = 0; j < n; j++, i++) {
+            if (buf[j] != (int)i)
+                g_errors++;
+        }
+    }
+    return NULL;
+}
+
+static double run(int use_kfifo) {
+    struct timespec t0, t1;
+    pthread_t r, w;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&w, NULL, write_thread, &use_kfifo);
+    pthread_create(&r, NULL, read_thread, &use_kfifo);
+    pthread_join(w, NULL);
+    pthread_join(r, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+int main() {
+    double t;
+
+    ringbuf_init(&g_ringbuf, sizeof(int), g_ringbuf_data, sizeof(g_ringbuf_data));
+    __kfifo_init(&g_kfifo, g_kfifo_data, sizeof(g_kfifo_data), sizeof(int));
+
+    t = run(0);
+    printf("ringbuf_t:     %u items in %.3fs, %.1f Mitems/s\n", COUNT, t, COUNT / t / 1e6);
+    t = run(1);
+    printf("struct __kfifo: %u items in %.3fs, %.1f Mitems/s\n", COUNT, t, COUNT / t / 1e6);
+
+    printf("errors: %d\n", g_errors);
+    return g_errors != 0;
+}
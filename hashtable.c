@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Resizable hash table over hlist, in the style of linux/hashtable.h
+ */
+
+#include "hashtable.h"
+#include <stdlib.h>
+#include <errno.h>
+
+static struct hlist_head *hash_alloc_buckets(unsigned int bits)
+{
+	/* an all-zero hlist_head is an empty one */
+	return calloc(1ul << bits, sizeof(struct hlist_head));
+}
+
+int hash_init(struct hashtable *ht, unsigned int bits)
+{
+	if (bits < HASH_MIN_BITS)
+		bits = HASH_MIN_BITS;
+	ht->table = hash_alloc_buckets(bits);
+	ht->old = NULL;
+	ht->bits = bits;
+	ht->old_bits = 0;
+	ht->old_pos = 0;
+	ht->count = 0;
+	ht->max_load = 1;
+	return ht->table ? 0 : -ENOMEM;
+}
+
+void hash_exit(struct hashtable *ht)
+{
+	free(ht->table);
+	free(ht->old);
+	ht->table = NULL;
+	ht->old = NULL;
+}
+
+/*
+ * move every entry of one old bucket to the new array
+ */
+static void hash_move_bucket(struct hashtable *ht, unsigned long bkt)
+{
+	struct hlist_node *pos, *n;
+	struct hash_node *node;
+
+	hlist_for_each_safe(pos, n, &ht->old[bkt]) {
+		node = hlist_entry(pos, struct hash_node, node);
+		__hlist_del(pos);
+		hlist_add_head(pos, &ht->table[hash_64(node->key, ht->bits)]);
+	}
+	INIT_HLIST_HEAD(&ht->old[bkt]);
+}
+
+static void hash_rehash_step(struct hashtable *ht, unsigned long steps)
+{
+	unsigned long size = 1ul << ht->old_bits;
+
+	while (steps-- && ht->old_pos < size)
+		hash_move_bucket(ht, ht->old_pos++);
+	if (ht->old_pos == size) {
+		free(ht->old);
+		ht->old = NULL;
+	}
+}
+
+void __hash_finish(struct hashtable *ht)
+{
+	if (ht->old)
+		hash_rehash_step(ht, ~0ul);
+}
+
+static void hash_resize(struct hashtable *ht, unsigned int bits)
+{
+	struct hlist_head *table;
+
+	__hash_finish(ht);
+	table = hash_alloc_buckets(bits);
+	if (!table)
+		return;		/* keep the current size */
+	ht->old = ht->table;
+	ht->old_bits = ht->bits;
+	ht->old_pos = 0;
+	ht->table = table;
+	ht->bits = bits;
+}
+
+void __hash_add(struct hashtable *ht, struct hash_node *node,
+		unsigned long key)
+{
+	unsigned long size = HASH_SIZE(ht);
+
+	if (ht->old)
+		hash_rehash_step(ht, HASH_REHASH_STEP);
+	else if (ht->max_load && ht->count >= size * ht->max_load && ht->bits < 63)
+		hash_resize(ht, ht->bits + 1);
+	else if (ht->count < size / 8 && ht->bits > HASH_MIN_BITS)
+		hash_resize(ht, ht->bits - 1);
+
+	node->key = key;
+	hlist_add_head(&node->node, &ht->table[hash_64(key, ht->bits)]);
+	ht->count++;
+}
+
+void __hash_del(struct hashtable *ht, struct hash_node *node)
+{
+	hlist_del_init(&node->node);
+	ht->count--;
+	if (ht->old)
+		hash_rehash_step(ht, HASH_REHASH_STEP);
+}
+
+struct hlist_head *__hash_bucket(struct hashtable *ht, unsigned long key)
+{
+	unsigned long bkt;
+
+	if (ht->old) {
+		bkt = hash_64(key, ht->old_bits);
+		if (bkt >= ht->old_pos && ht->old[bkt].first)
+			hash_move_bucket(ht, bkt);
+	}
+	return &ht->table[hash_64(key, ht->bits)];
+}
@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Resizable hash table over hlist, in the style of linux/hashtable.h
+ */
+
+#ifndef _LINUX_HASHTABLE_H
+#define _LINUX_HASHTABLE_H
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Unlike the kernel's fixed-size DEFINE_HASHTABLE(), a struct hashtable
+ * doubles its bucket array when it holds more than max_load entries per
+ * bucket and halves it when it falls below one per 8 buckets. Both are
+ * decided in hash_add(), so hash_del() never starts a resize.
+ *
+ * Resizing is incremental: the old array is kept next to the new one and
+ * every hash_add() and hash_del() moves HASH_REHASH_STEP old buckets over, so
+ * no single operation pays for the whole table. A lookup first moves the one
+ * old bucket its key hashes to, after that every entry with that key is in
+ * the new array and hash_for_each_possible() walks a single bucket, exactly
+ * like the kernel macro.
+ *
+ * To be moved, an entry must know its key: embed a struct hash_node (an
+ * hlist_node plus the key) instead of a bare hlist_node.
+ *
+ * There is no locking, a table that is used by several threads needs a lock
+ * around every operation, lookups included (they may move a bucket).
+ */
+
+#define HASH_REHASH_STEP	4
+#define HASH_MIN_BITS		3
+
+#define GOLDEN_RATIO_64 0x61C8864680B583EBull
+
+static inline unsigned int hash_64(unsigned long long val, unsigned int bits)
+{
+	/* High bits are more random, so use them. */
+	return (unsigned int)((val * GOLDEN_RATIO_64) >> (64 - bits));
+}
+
+struct hash_node {
+	struct hlist_node	node;
+	unsigned long		key;
+};
+
+struct hashtable {
+	struct hlist_head	*table;
+	struct hlist_head	*old;		/* being emptied into table, or NULL */
+	unsigned int		bits;
+	unsigned int		old_bits;
+	unsigned long		old_pos;	/* old buckets below this are empty */
+	unsigned long		count;
+	unsigned int		max_load;	/* 0: never grow */
+};
+
+#define HASH_SIZE(ht)	(1ul << (ht)->bits)
+
+/**
+ * hash_init - initialize a hash table
+ * @ht: hashtable to be initialized
+ * @bits: log2 of the initial number of buckets
+ *
+ * max_load starts at 1 and may be changed afterwards.
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int hash_init(struct hashtable *ht, unsigned int bits);
+
+/**
+ * hash_exit - free the bucket arrays
+ * @ht: hashtable to be freed
+ *
+ * The entries are not touched.
+ */
+extern void hash_exit(struct hashtable *ht);
+
+extern void __hash_add(struct hashtable *ht, struct hash_node *node,
+	unsigned long key);
+extern void __hash_del(struct hashtable *ht, struct hash_node *node);
+extern struct hlist_head *__hash_bucket(struct hashtable *ht,
+	unsigned long key);
+extern void __hash_finish(struct hashtable *ht);
+
+/**
+ * hash_add - add an object to a hashtable
+ * @ht: hashtable to add to
+ * @node: the &struct hash_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add(ht, node, key)	__hash_add(ht, node, key)
+
+/**
+ * hash_del - remove an object from a hashtable
+ * @ht: hashtable to remove from
+ * @node: &struct hash_node of the object to remove
+ */
+#define hash_del(ht, node)	__hash_del(ht, node)
+
+/**
+ * hash_hashed - check whether an object is in any hashtable
+ * @node: the &struct hash_node of the object to be checked
+ */
+static inline bool hash_hashed(struct hash_node *node)
+{
+	return !hlist_unhashed(&node->node);
+}
+
+/**
+ * hash_empty - check whether a hashtable is empty
+ * @ht: hashtable to check
+ */
+static inline bool hash_empty(struct hashtable *ht)
+{
+	return !ht->count;
+}
+
+/**
+ * hash_for_each - iterate over a hashtable
+ * @ht: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hash_node within the struct
+ *
+ * Finishes a resize in progress first.
+ */
+#define hash_for_each(ht, bkt, obj, member)				\
+	for (__hash_finish(ht), (bkt) = 0, obj = NULL;			\
+	     obj == NULL && (bkt) < HASH_SIZE(ht); (bkt)++)		\
+		hlist_for_each_entry(obj, &(ht)->table[bkt], member.node)
+
+/**
+ * hash_for_each_safe - iterate over a hashtable safe against removal of
+ * hash entry
+ * @ht: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @tmp: a &struct hlist_node used for temporary storage
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hash_node within the struct
+ */
+#define hash_for_each_safe(ht, bkt, tmp, obj, member)			\
+	for (__hash_finish(ht), (bkt) = 0, obj = NULL;			\
+	     obj == NULL && (bkt) < HASH_SIZE(ht); (bkt)++)		\
+		hlist_for_each_entry_safe(obj, tmp, &(ht)->table[bkt], member.node)
+
+/**
+ * hash_for_each_possible - iterate over all possible objects hashing to the
+ * same bucket
+ * @ht: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hash_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible(ht, obj, member, key)			\
+	hlist_for_each_entry(obj, __hash_bucket(ht, key), member.node)
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
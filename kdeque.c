@@ -0,0 +1,161 @@
+/*
+ * Chase-Lev work-stealing deque, using kfifo style power-of-2 buffers
+ *
+ * Memory ordering follows "Correct and Efficient Work-Stealing for Weak
+ * Memory Models" (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+ */
+
+#include "kdeque.h"
+#include <string.h>
+
+static inline unsigned int roundup_pow_of_two(unsigned int v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v++;
+	return v;
+}
+
+static struct __kdeque_buf *kdeque_buf_alloc(unsigned int size, size_t esize)
+{
+	struct __kdeque_buf *buf = malloc(sizeof(*buf) + (size_t)size * esize);
+
+	if (buf) {
+		buf->mask = size - 1;
+		buf->prev = NULL;
+	}
+	return buf;
+}
+
+static inline void *kdeque_slot(struct __kdeque_buf *buf, long i, size_t esize)
+{
+	return buf->data + (i & buf->mask) * esize;
+}
+
+int __kdeque_alloc(struct __kdeque *deque, unsigned int size, size_t esize)
+{
+	size = roundup_pow_of_two(size);
+
+	deque->top = 0;
+	deque->bottom = 0;
+	deque->esize = esize;
+	deque->buf = NULL;
+
+	if (size < 2)
+		return -EINVAL;
+
+	deque->buf = kdeque_buf_alloc(size, esize);
+	if (!deque->buf)
+		return -ENOMEM;
+	return 0;
+}
+
+void __kdeque_free(struct __kdeque *deque)
+{
+	struct __kdeque_buf *buf = deque->buf, *prev;
+
+	while (buf) {
+		prev = buf->prev;
+		free(buf);
+		buf = prev;
+	}
+	deque->buf = NULL;
+	deque->top = 0;
+	deque->bottom = 0;
+}
+
+unsigned int __kdeque_len(struct __kdeque *deque)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+	long t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+	return b > t ? b - t : 0;
+}
+
+/*
+ * replace a full buffer by one of twice the size, owner only
+ */
+static struct __kdeque_buf *kdeque_grow(struct __kdeque *deque,
+					struct __kdeque_buf *old,
+					long top, long bottom)
+{
+	struct __kdeque_buf *buf;
+	long i;
+
+	buf = kdeque_buf_alloc((old->mask + 1) * 2, deque->esize);
+	if (!buf)
+		return NULL;
+	for (i = top; i < bottom; i++)
+		memcpy(kdeque_slot(buf, i, deque->esize),
+		       kdeque_slot(old, i, deque->esize), deque->esize);
+	buf->prev = old;
+	__atomic_store_n(&deque->buf, buf, __ATOMIC_RELEASE);
+	return buf;
+}
+
+unsigned int __kdeque_push(struct __kdeque *deque, const void *val)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+	long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	struct __kdeque_buf *buf = __atomic_load_n(&deque->buf, __ATOMIC_RELAXED);
+
+	if (b - t > (long)buf->mask) {
+		buf = kdeque_grow(deque, buf, t, b);
+		if (!buf)
+			return 0;
+	}
+	memcpy(kdeque_slot(buf, b, deque->esize), val, deque->esize);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+unsigned int __kdeque_pop(struct __kdeque *deque, void *val)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	struct __kdeque_buf *buf = __atomic_load_n(&deque->buf, __ATOMIC_RELAXED);
+	unsigned int ret = 1;
+	long t;
+
+	__atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+	if (t > b) {
+		/* empty */
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	memcpy(val, kdeque_slot(buf, b, deque->esize), deque->esize);
+	if (t == b) {
+		/* last element, race against the thieves for it */
+		if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+						 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			ret = 0;
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return ret;
+}
+
+int __kdeque_steal(struct __kdeque *deque, void *val)
+{
+	long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	struct __kdeque_buf *buf;
+	long b;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+		return 0;
+
+	buf = __atomic_load_n(&deque->buf, __ATOMIC_ACQUIRE);
+	memcpy(val, kdeque_slot(buf, t, deque->esize), deque->esize);
+	if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return -EAGAIN;
+	return 1;
+}
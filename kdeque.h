@@ -0,0 +1,163 @@
+/*
+ * Chase-Lev work-stealing deque, using kfifo style power-of-2 buffers
+ */
+
+#ifndef _KDEQUE_H
+#define _KDEQUE_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Note about locking: a kdeque has one owner thread, which may call
+ * kdeque_push() and kdeque_pop() (LIFO end), and any number of thief threads,
+ * which may call kdeque_steal() (FIFO end). None of them need a lock.
+ *
+ * The storage is a power-of-2 ring indexed with `index & mask`, like
+ * struct __kfifo. When kdeque_push() finds it full, it is replaced by one of
+ * twice the size; the old buffer may still be read by a thief, so it is kept
+ * until kdeque_free().
+ *
+ * A thief copies the element before it knows whether it won the race for it,
+ * a lost copy is simply discarded. Keep elements small (a pointer or a task
+ * descriptor of a few words).
+ */
+
+struct __kdeque_buf {
+	unsigned int		mask;
+	struct __kdeque_buf	*prev;		/* retired buffers */
+	unsigned char		data[];
+};
+
+struct __kdeque {
+	long			top ____cacheline_aligned;	/* thieves */
+	long			bottom ____cacheline_aligned;	/* owner */
+	struct __kdeque_buf	*buf;
+	size_t			esize;
+};
+
+#define __STRUCT_KDEQUE_COMMON(datatype) \
+	union { \
+		struct __kdeque	kdeque; \
+		datatype	*type; \
+		const datatype	*const_type; \
+	}
+
+#define STRUCT_KDEQUE(type) \
+	struct { \
+		__STRUCT_KDEQUE_COMMON(type); \
+	}
+
+/**
+ * DECLARE_KDEQUE - macro to declare a work-stealing deque object
+ * @deque: name of the declared deque
+ * @type: type of the deque elements
+ */
+#define DECLARE_KDEQUE(deque, type)	STRUCT_KDEQUE(type) deque
+
+/**
+ * kdeque_alloc - dynamically allocates a new deque buffer
+ * @deque: pointer to the deque
+ * @size: the initial number of elements, rounded-up to a power of 2
+ *
+ * The deque grows when it is full and is released with kdeque_free().
+ * Return 0 if no error, otherwise an error code.
+ */
+#define kdeque_alloc(deque, size) \
+__kfifo_int_must_check_helper( \
+({ \
+	typeof((deque) + 1) __tmp = (deque); \
+	__kdeque_alloc(&__tmp->kdeque, size, sizeof(*__tmp->type)); \
+}) \
+)
+
+/**
+ * kdeque_free - frees the deque and all the buffers it grew out of
+ * @deque: the deque to be freed
+ */
+#define kdeque_free(deque) \
+({ \
+	typeof((deque) + 1) __tmp = (deque); \
+	__kdeque_free(&__tmp->kdeque); \
+})
+
+/**
+ * kdeque_len - returns the number of elements in the deque
+ * @deque: address of the deque to be used
+ *
+ * Only a snapshot while thieves are running.
+ */
+#define kdeque_len(deque) \
+({ \
+	typeof((deque) + 1) __tmpl = (deque); \
+	__kdeque_len(&__tmpl->kdeque); \
+})
+
+/**
+ * kdeque_push - put an element at the owner's end
+ * @deque: address of the deque to be used
+ * @val: the element to be added
+ *
+ * Owner thread only. Return 1, or 0 if growing the deque failed.
+ */
+#define kdeque_push(deque, val) \
+({ \
+	typeof((deque) + 1) __tmp = (deque); \
+	typeof(*__tmp->const_type) __val = (val); \
+	__kdeque_push(&__tmp->kdeque, &__val); \
+})
+
+/**
+ * kdeque_pop - take the most recently pushed element
+ * @deque: address of the deque to be used
+ * @val: address where to store the element
+ *
+ * Owner thread only. Return 1, or 0 if the deque was empty.
+ */
+#define kdeque_pop(deque, val) \
+__kfifo_uint_must_check_helper( \
+({ \
+	typeof((deque) + 1) __tmp = (deque); \
+	typeof(__tmp->type) __val = (val); \
+	__kdeque_pop(&__tmp->kdeque, __val); \
+}) \
+)
+
+/**
+ * kdeque_steal - take the oldest element
+ * @deque: address of the deque to be used
+ * @val: address where to store the element
+ *
+ * Any thread. Return 1, 0 if the deque was empty, or -EAGAIN if another
+ * thread took the element first (the caller may retry or move on).
+ */
+#define kdeque_steal(deque, val) \
+__kfifo_int_must_check_helper( \
+({ \
+	typeof((deque) + 1) __tmp = (deque); \
+	typeof(__tmp->type) __val = (val); \
+	__kdeque_steal(&__tmp->kdeque, __val); \
+}) \
+)
+
+extern int __kdeque_alloc(struct __kdeque *deque, unsigned int size,
+	size_t esize);
+
+extern void __kdeque_free(struct __kdeque *deque);
+
+extern unsigned int __kdeque_len(struct __kdeque *deque);
+
+extern unsigned int __kdeque_push(struct __kdeque *deque, const void *val);
+
+extern unsigned int __kdeque_pop(struct __kdeque *deque, void *val);
+
+extern int __kdeque_steal(struct __kdeque *deque, void *val);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
@@ -8,9 +8,17 @@
 https://github.com/liigo/kfifo
 */
 
+#if defined(CONFIG_KFIFO_LATENCY) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "kfifo.h"
+#include "kfifo_trace.h"
 #include <memory.h>
 #include <stdlib.h>
+#ifdef CONFIG_KFIFO_LATENCY
+#include <time.h>
+#endif
 
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
@@ -46,6 +54,255 @@ static inline unsigned int kfifo_unused(struct __kfifo* fifo)
     return (fifo->mask + 1) - (fifo->in - fifo->out);
 }
 
+#ifdef CONFIG_KFIFO_STATS
+/*
+ * statistics hooks, each one is only called from its own side of the fifo
+ */
+static inline void kfifo_stats_in(struct __kfifo* fifo, unsigned int want, unsigned int got, unsigned int bytes)
+{
+    struct kfifo_stats* stats = fifo->stats;
+    unsigned int used;
+
+    if (!stats)
+        return;
+    stats->in.items += got;
+    stats->in.bytes += bytes;
+    if (got < want)
+        stats->in.full++;
+    used = fifo->in - fifo->out;
+    if (used > stats->in.high_water)
+        stats->in.high_water = used;
+}
+
+static inline void kfifo_stats_out(struct __kfifo* fifo, unsigned int want, unsigned int got, unsigned int bytes)
+{
+    struct kfifo_stats* stats = fifo->stats;
+
+    if (!stats)
+        return;
+    stats->out.items += got;
+    stats->out.bytes += bytes;
+    if (want && !got)
+        stats->out.empty++;
+}
+
+static inline void kfifo_stats_truncated(struct __kfifo* fifo)
+{
+    if (fifo->stats)
+        fifo->stats->in.truncated++;
+}
+
+void __kfifo_stats_attach(struct __kfifo* fifo, struct kfifo_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    fifo->stats = stats;
+}
+
+#define __KFIFO_READ(x) (*(volatile typeof(x)*)&(x))
+
+int __kfifo_stats_snapshot(struct __kfifo* fifo, struct kfifo_stats_snapshot* snap)
+{
+    struct kfifo_stats* stats = fifo->stats;
+
+    if (!stats)
+        return -EINVAL;
+    snap->in_items = __KFIFO_READ(stats->in.items);
+    snap->in_bytes = __KFIFO_READ(stats->in.bytes);
+    snap->in_full = __KFIFO_READ(stats->in.full);
+    snap->in_truncated = __KFIFO_READ(stats->in.truncated);
+    snap->high_water = __KFIFO_READ(stats->in.high_water);
+    snap->out_items = __KFIFO_READ(stats->out.items);
+    snap->out_bytes = __KFIFO_READ(stats->out.bytes);
+    snap->out_empty = __KFIFO_READ(stats->out.empty);
+    snap->len = __KFIFO_READ(fifo->in) - __KFIFO_READ(fifo->out);
+    snap->size = fifo->mask + 1;
+    return 0;
+}
+#else
+#define kfifo_stats_in(fifo, want, got, bytes) ((void)(want))
+#define kfifo_stats_out(fifo, want, got, bytes) ((void)(want))
+#define kfifo_stats_truncated(fifo) do { } while (0)
+#endif
+
+#ifdef CONFIG_KFIFO_LATENCY
+#define KFIFO_HIST_SUB_MASK ((1u << KFIFO_HIST_SUB_BITS) - 1)
+
+unsigned long long kfifo_clock(void)
+{
+#if defined(CONFIG_KFIFO_LATENCY_TSC) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static inline unsigned int kfifo_hist_index(unsigned long long v)
+{
+    unsigned int shift;
+
+    if (v <= KFIFO_HIST_SUB_MASK)
+        return v;
+    shift = 63 - __builtin_clzll(v) - KFIFO_HIST_SUB_BITS;
+    return ((shift + 1) << KFIFO_HIST_SUB_BITS) + ((v >> shift) & KFIFO_HIST_SUB_MASK);
+}
+
+/*
+ * the largest value that falls into bucket idx
+ */
+static unsigned long long kfifo_hist_upper(unsigned int idx)
+{
+    unsigned int shift;
+
+    if (idx <= KFIFO_HIST_SUB_MASK)
+        return idx;
+    shift = (idx >> KFIFO_HIST_SUB_BITS) - 1;
+    return (((KFIFO_HIST_SUB_MASK + 1ull) + (idx & KFIFO_HIST_SUB_MASK) + 1) << shift) - 1;
+}
+
+/*
+ * single writer (the consumer), relaxed stores so that kfifo_hist_read()
+ * never sees a torn counter
+ */
+static inline void kfifo_hist_add(struct kfifo_hist* hist, unsigned long long v, unsigned int n)
+{
+    unsigned long long* count = &hist->count[kfifo_hist_index(v)];
+
+    __atomic_store_n(count, *count + n, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->total, hist->total + n, __ATOMIC_RELAXED);
+    if (v > hist->max)
+        __atomic_store_n(&hist->max, v, __ATOMIC_RELAXED);
+}
+
+void kfifo_hist_read(const struct kfifo_hist* hist, struct kfifo_hist* copy)
+{
+    unsigned int i;
+
+    for (i = 0; i < KFIFO_HIST_BUCKETS; i++)
+        copy->count[i] = __atomic_load_n(&hist->count[i], __ATOMIC_RELAXED);
+    copy->total = __atomic_load_n(&hist->total, __ATOMIC_RELAXED);
+    copy->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+}
+
+unsigned long long kfifo_hist_percentile(const struct kfifo_hist* hist, double p)
+{
+    unsigned long long total = 0, target, seen = 0;
+    unsigned int i;
+
+    for (i = 0; i < KFIFO_HIST_BUCKETS; i++)
+        total += hist->count[i];
+    if (!total)
+        return 0;
+    target = (unsigned long long)(total * p / 100);
+    if (target >= total)
+        target = total - 1;
+    for (i = 0; i < KFIFO_HIST_BUCKETS; i++)
+    {
+        seen += hist->count[i];
+        if (seen > target)
+            break;
+    }
+    return min(kfifo_hist_upper(i), hist->max);
+}
+
+void __kfifo_latency_attach(struct __kfifo* fifo, struct kfifo_latency* lat, unsigned long long* stamps)
+{
+    memset(lat, 0, sizeof(*lat));
+    lat->stamps = stamps;
+    fifo->latency = lat;
+}
+
+/*
+ * stamp n elements starting at off, one clock read per call
+ */
+static void kfifo_latency_in(struct __kfifo* fifo, unsigned int off, unsigned int n)
+{
+    struct kfifo_latency* lat = fifo->latency;
+    unsigned long long now;
+
+    if (!lat || !n)
+        return;
+    now = kfifo_clock();
+    while (n--)
+        lat->stamps[off++ & fifo->mask] = now;
+}
+
+/*
+ * account n elements starting at off, elements stored by the same
+ * kfifo_latency_in() call share their stamp and one histogram update
+ */
+static void kfifo_latency_out(struct __kfifo* fifo, unsigned int off, unsigned int n)
+{
+    struct kfifo_latency* lat = fifo->latency;
+    unsigned long long now, stamp;
+    unsigned int run;
+
+    if (!lat || !n)
+        return;
+    now = kfifo_clock();
+    while (n)
+    {
+        stamp = lat->stamps[off & fifo->mask];
+        run = 0;
+        do
+        {
+            off++;
+            run++;
+            n--;
+        } while (n && lat->stamps[off & fifo->mask] == stamp);
+        kfifo_hist_add(&lat->hist, now > stamp ? now - stamp : 0, run);
+    }
+}
+#else
+#define kfifo_latency_in(fifo, off, n) do { } while (0)
+#define kfifo_latency_out(fifo, off, n) do { } while (0)
+#endif
+
+int __kfifo_alloc(struct __kfifo* fifo, unsigned int size, size_t esize)
+{
+    /*
+     * round up to the next power of 2, since our 'let the indices
+     * wrap' technique works only in this case.
+     */
+    size = roundup_pow_of_two(size);
+
+    fifo->in = 0;
+    fifo->out = 0;
+    fifo->esize = esize;
+    __kfifo_init_stats(fifo);
+    __kfifo_init_latency(fifo);
+
+    if (size < 2)
+    {
+        fifo->data = NULL;
+        fifo->mask = 0;
+        return -EINVAL;
+    }
+
+    fifo->data = calloc(size, esize);
+
+    if (!fifo->data)
+    {
+        fifo->mask = 0;
+        return -ENOMEM;
+    }
+    fifo->mask = size - 1;
+
+    return 0;
+}
+
+void __kfifo_free(struct __kfifo* fifo)
+{
+    free(fifo->data);
+    fifo->in = 0;
+    fifo->out = 0;
+    fifo->esize = 0;
+    fifo->data = NULL;
+    fifo->mask = 0;
+}
+
 int __kfifo_init(struct __kfifo* fifo, void* buffer, unsigned int size, size_t esize)
 {
     size /= esize;
@@ -55,6 +312,8 @@ int __kfifo_init(struct __kfifo* fifo, void* buffer, unsigned int size, size_t e
     fifo->out = 0;
     fifo->esize = esize;
     fifo->data = buffer;
+    __kfifo_init_stats(fifo);
+    __kfifo_init_latency(fifo);
 
     if (size < 2)
     {
@@ -93,13 +352,19 @@ static void kfifo_copy_in(struct __kfifo* fifo, const void* src, unsigned int le
 unsigned int __kfifo_in(struct __kfifo* fifo, const void* buf, unsigned int len)
 {
     unsigned int l;
+    unsigned int want = len;
 
     l = kfifo_unused(fifo);
     if (len > l)
         len = l;
 
+    kfifo_latency_in(fifo, fifo->in, len);
     kfifo_copy_in(fifo, buf, len, fifo->in);
     fifo->in += len;
+    kfifo_stats_in(fifo, want, len, len * fifo->esize);
+    if (len < want)
+        KFIFO_TRACE3(kfifo, full, fifo, want, fifo->in - fifo->out);
+    KFIFO_TRACE3(kfifo, in, fifo, len, fifo->in - fifo->out);
     return len;
 }
 
@@ -141,8 +406,15 @@ unsigned int __kfifo_out_peek(struct __kfifo* fifo, void* buf, unsigned int len)
 
 unsigned int __kfifo_out(struct __kfifo* fifo, void* buf, unsigned int len)
 {
+    unsigned int want = len;
+
     len = __kfifo_out_peek(fifo, buf, len);
+    kfifo_latency_out(fifo, fifo->out, len);
     fifo->out += len;
+    kfifo_stats_out(fifo, want, len, len * fifo->esize);
+    if (want && !len)
+        KFIFO_TRACE1(kfifo, empty, fifo);
+    KFIFO_TRACE3(kfifo, out, fifo, len, fifo->in - fifo->out);
     return len;
 }
 
@@ -199,12 +471,21 @@ unsigned int __kfifo_len_r(struct __kfifo* fifo, size_t recsize)
 unsigned int __kfifo_in_r(struct __kfifo* fifo, const void* buf, unsigned int len, size_t recsize)
 {
     if (len + recsize > kfifo_unused(fifo))
+    {
+        kfifo_stats_in(fifo, 1, 0, 0);
+        KFIFO_TRACE3(kfifo, full, fifo, len, fifo->in - fifo->out);
         return 0;
+    }
+    if (len > __kfifo_max_r(len, recsize))
+        kfifo_stats_truncated(fifo);
 
     __kfifo_poke_n(fifo, len, recsize);
 
+    kfifo_latency_in(fifo, fifo->in, 1);
     kfifo_copy_in(fifo, buf, len, fifo->in + recsize);
     fifo->in += len + recsize;
+    kfifo_stats_in(fifo, 1, 1, len);
+    KFIFO_TRACE3(kfifo, in_r, fifo, len, fifo->in - fifo->out);
     return len;
 }
 
@@ -234,10 +515,17 @@ unsigned int __kfifo_out_r(struct __kfifo* fifo, void* buf, unsigned int len, si
     unsigned int n;
 
     if (fifo->in == fifo->out)
+    {
+        kfifo_stats_out(fifo, 1, 0, 0);
+        KFIFO_TRACE1(kfifo, empty, fifo);
         return 0;
+    }
 
     len = kfifo_out_copy_r(fifo, buf, len, recsize, &n);
+    kfifo_latency_out(fifo, fifo->out, 1);
     fifo->out += n + recsize;
+    kfifo_stats_out(fifo, 1, 1, n);
+    KFIFO_TRACE3(kfifo, out_r, fifo, n, fifo->in - fifo->out);
     return len;
 }
 
@@ -246,5 +534,7 @@ void __kfifo_skip_r(struct __kfifo* fifo, size_t recsize)
     unsigned int n;
 
     n = __kfifo_peek_n(fifo, recsize);
+    kfifo_latency_out(fifo, fifo->out, 1);
     fifo->out += n + recsize;
+    kfifo_stats_out(fifo, 1, 1, n);
 }
@@ -53,12 +53,85 @@ extern "C" {
 	#define smp_wmb __sync_synchronize
 #endif
 
+#ifndef ____cacheline_aligned
+	#ifdef __GNUC__
+		#define ____cacheline_aligned __attribute__((__aligned__(64)))
+	#else
+		#define ____cacheline_aligned
+	#endif
+#endif
+
+#ifdef CONFIG_KFIFO_STATS
+/*
+ * Hot-path statistics, see kfifo_stats_attach(). Each half is only written
+ * by its own side of the fifo and lives in its own cache line.
+ */
+struct kfifo_stats {
+	struct {
+		unsigned long long	items;		/* elements or records stored */
+		unsigned long long	bytes;
+		unsigned long long	full;		/* calls that could not store everything */
+		unsigned long long	truncated;	/* records longer than __kfifo_max_r() */
+		unsigned int		high_water;	/* max. occupancy in elements */
+	} in ____cacheline_aligned;
+	struct {
+		unsigned long long	items;		/* elements or records removed */
+		unsigned long long	bytes;
+		unsigned long long	empty;		/* calls that found the fifo empty */
+	} out ____cacheline_aligned;
+};
+
+struct kfifo_stats_snapshot {
+	unsigned long long	in_items;
+	unsigned long long	in_bytes;
+	unsigned long long	in_full;
+	unsigned long long	in_truncated;
+	unsigned long long	out_items;
+	unsigned long long	out_bytes;
+	unsigned long long	out_empty;
+	unsigned int		high_water;
+	unsigned int		len;
+	unsigned int		size;
+};
+#endif
+
+#ifdef CONFIG_KFIFO_LATENCY
+/*
+ * Log-bucketed (HDR style) histogram: values below 2^KFIFO_HIST_SUB_BITS get
+ * their own bucket, above that every power of two is split into
+ * 2^KFIFO_HIST_SUB_BITS buckets, so the relative error stays below 1/16.
+ */
+#define KFIFO_HIST_SUB_BITS	4
+#define KFIFO_HIST_BUCKETS	(64 << KFIFO_HIST_SUB_BITS)
+
+struct kfifo_hist {
+	unsigned long long	count[KFIFO_HIST_BUCKETS];
+	unsigned long long	total;
+	unsigned long long	max;
+};
+
+/*
+ * Enqueue-to-dequeue latency, see kfifo_latency_attach(). The stamps are
+ * written by the producer, the histogram only by the consumer.
+ */
+struct kfifo_latency {
+	unsigned long long	*stamps;
+	struct kfifo_hist	hist ____cacheline_aligned;
+};
+#endif
+
 struct __kfifo {
 	unsigned int	in;
 	unsigned int	out;
 	unsigned int	mask;
 	unsigned int	esize;
 	void		*data;
+#ifdef CONFIG_KFIFO_STATS
+	struct kfifo_stats	*stats;
+#endif
+#ifdef CONFIG_KFIFO_LATENCY
+	struct kfifo_latency	*latency;
+#endif
 };
 
 #define __STRUCT_KFIFO_COMMON(datatype, recsize, ptrtype) \
@@ -142,6 +215,8 @@ struct kfifo_rec_ptr_2 __STRUCT_KFIFO_PTR(unsigned char, 2, void);
 	__kfifo->mask = ARRAY_SIZE(__tmp->buf) - 1;\
 	__kfifo->esize = sizeof(*__tmp->buf); \
 	__kfifo->data = __tmp->buf; \
+	__kfifo_init_stats(__kfifo); \
+	__kfifo_init_latency(__kfifo); \
 })
 
 /**
@@ -171,6 +246,18 @@ struct kfifo_rec_ptr_2 __STRUCT_KFIFO_PTR(unsigned char, 2, void);
 	}
 
 
+#ifdef CONFIG_KFIFO_STATS
+#define __kfifo_init_stats(fifo)	((fifo)->stats = NULL)
+#else
+#define __kfifo_init_stats(fifo)	((void)0)
+#endif
+
+#ifdef CONFIG_KFIFO_LATENCY
+#define __kfifo_init_latency(fifo)	((fifo)->latency = NULL)
+#else
+#define __kfifo_init_latency(fifo)	((void)0)
+#endif
+
 static inline unsigned int __must_check
 __kfifo_uint_must_check_helper(unsigned int val)
 {
@@ -498,6 +585,78 @@ __kfifo_uint_must_check_helper( \
 }) \
 )
 
+#ifdef CONFIG_KFIFO_STATS
+/**
+ * kfifo_stats_attach - enable statistics for a fifo
+ * @fifo: address of the fifo to be used
+ * @stats: zeroed by this call, must stay valid as long as the fifo is used
+ *
+ * Only available when built with CONFIG_KFIFO_STATS. Call it after the fifo
+ * is initialized and before it is shared with other threads.
+ */
+#define kfifo_stats_attach(fifo, stats) \
+	__kfifo_stats_attach(&(fifo)->stkfifo, stats)
+
+/**
+ * kfifo_stats_snapshot - read the statistics of a fifo
+ * @fifo: address of the fifo to be used
+ * @snap: address of a struct kfifo_stats_snapshot to fill in
+ *
+ * Can be called from any thread while the fifo is in use, the counters are
+ * read without stopping the producer or the consumer.
+ * Return 0, or -EINVAL if no statistics are attached.
+ */
+#define kfifo_stats_snapshot(fifo, snap) \
+	__kfifo_stats_snapshot(&(fifo)->stkfifo, snap)
+
+extern void __kfifo_stats_attach(struct __kfifo *fifo,
+	struct kfifo_stats *stats);
+
+extern int __kfifo_stats_snapshot(struct __kfifo *fifo,
+	struct kfifo_stats_snapshot *snap);
+#endif
+
+#ifdef CONFIG_KFIFO_LATENCY
+/**
+ * kfifo_latency_attach - record how long elements stay in a fifo
+ * @fifo: address of the fifo to be used
+ * @lat: latency block, zeroed by this call
+ * @stamps: side storage for kfifo_size(fifo) timestamps
+ *
+ * Only available when built with CONFIG_KFIFO_LATENCY. Every kfifo_in()
+ * stamps the stored elements (or the record) with one clock read per call,
+ * every kfifo_out() adds their queueing delay to @lat->hist, one histogram
+ * update per run of elements enqueued by the same call. The clock is
+ * CLOCK_MONOTONIC in nanoseconds, or the TSC in cycles when built with
+ * CONFIG_KFIFO_LATENCY_TSC on x86.
+ *
+ * Call it on an empty fifo, before it is shared with other threads.
+ */
+#define kfifo_latency_attach(fifo, lat, stamps) \
+	__kfifo_latency_attach(&(fifo)->stkfifo, lat, stamps)
+
+extern void __kfifo_latency_attach(struct __kfifo *fifo,
+	struct kfifo_latency *lat, unsigned long long *stamps);
+
+/*
+ * kfifo_hist_read() copies a histogram that is being updated concurrently,
+ * kfifo_hist_percentile() returns the upper bound of the bucket holding the
+ * p-th percentile (0 <= p <= 100) of a copy.
+ */
+extern void kfifo_hist_read(const struct kfifo_hist *hist,
+	struct kfifo_hist *copy);
+
+extern unsigned long long kfifo_hist_percentile(const struct kfifo_hist *hist,
+	double p);
+
+extern unsigned long long kfifo_clock(void);
+#endif
+
+extern int __kfifo_alloc(struct __kfifo *fifo, unsigned int size,
+	size_t esize);
+
+extern void __kfifo_free(struct __kfifo *fifo);
+
 extern int __kfifo_init(struct __kfifo *fifo, void *buffer,
 	unsigned int size, size_t esize);
 
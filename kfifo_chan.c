@@ -0,0 +1,239 @@
+/*
+ * Duplex request/response channel on a pair of SPSC kfifos
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "kfifo_chan.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define KFIFO_CHAN_SPINS	2000
+
+#define min(x, y) ((x) < (y) ? (x) : (y))
+
+static inline unsigned int roundup_pow_of_two(unsigned int v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v++;
+	return v;
+}
+
+static inline void kfifo_chan_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static void kfifo_chan_park(int *word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)word;
+	sched_yield();
+#endif
+}
+
+static void kfifo_chan_unpark(int *word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)word;
+#endif
+}
+
+static int kfifo_chan_ring_alloc(struct kfifo_chan_ring *ring, unsigned int size)
+{
+	size = roundup_pow_of_two(size);
+
+	ring->in = 0;
+	ring->out_cache = 0;
+	ring->out = 0;
+	ring->in_cache = 0;
+	ring->parked = 0;
+	ring->data = NULL;
+	ring->mask = 0;
+
+	if (size < 2)
+		return -EINVAL;
+
+	ring->data = calloc(size, sizeof(*ring->data));
+	if (!ring->data)
+		return -ENOMEM;
+	ring->mask = size - 1;
+	return 0;
+}
+
+static void kfifo_chan_ring_free(struct kfifo_chan_ring *ring)
+{
+	free(ring->data);
+	ring->data = NULL;
+	ring->mask = 0;
+}
+
+static unsigned int kfifo_chan_put(struct kfifo_chan_ring *ring,
+				   const struct kfifo_msg *msgs,
+				   unsigned int n, int flags)
+{
+	struct kfifo_msg *data = ring->data;
+	unsigned int size = ring->mask + 1;
+	unsigned int in = ring->in;
+	unsigned int off, l;
+
+	if (size - (in - ring->out_cache) < n) {
+		ring->out_cache = __atomic_load_n(&ring->out, __ATOMIC_ACQUIRE);
+		l = size - (in - ring->out_cache);
+		if (l < n)
+			n = l;
+	}
+	if (!n)
+		return 0;
+
+	off = in & ring->mask;
+	l = min(n, size - off);
+	memcpy(data + off, msgs, l * sizeof(*msgs));
+	memcpy(data, msgs + l, (n - l) * sizeof(*msgs));
+	__atomic_store_n(&ring->in, in + n, __ATOMIC_RELEASE);
+
+	if (flags & KFIFO_CHAN_PARK) {
+		/* pairs with the fence in kfifo_chan_wait_ring() */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->parked, __ATOMIC_RELAXED) &&
+		    __atomic_exchange_n(&ring->parked, 0, __ATOMIC_RELAXED))
+			kfifo_chan_unpark(&ring->parked);
+	}
+	return n;
+}
+
+static unsigned int kfifo_chan_get(struct kfifo_chan_ring *ring,
+				   struct kfifo_msg *msgs, unsigned int n)
+{
+	struct kfifo_msg *data = ring->data;
+	unsigned int size = ring->mask + 1;
+	unsigned int out = ring->out;
+	unsigned int off, l;
+
+	if (ring->in_cache - out < n) {
+		ring->in_cache = __atomic_load_n(&ring->in, __ATOMIC_ACQUIRE);
+		l = ring->in_cache - out;
+		if (l < n)
+			n = l;
+	}
+	if (!n)
+		return 0;
+
+	off = out & ring->mask;
+	l = min(n, size - off);
+	memcpy(msgs, data + off, l * sizeof(*msgs));
+	memcpy(msgs + l, data, (n - l) * sizeof(*msgs));
+	__atomic_store_n(&ring->out, out + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+static unsigned int kfifo_chan_wait_ring(struct kfifo_chan_ring *ring,
+					 struct kfifo_msg *msgs,
+					 unsigned int n, int flags)
+{
+	unsigned int i, ret;
+
+	for (;;) {
+		for (i = 0; i < KFIFO_CHAN_SPINS; i++) {
+			ret = kfifo_chan_get(ring, msgs, n);
+			if (ret)
+				return ret;
+			kfifo_chan_pause();
+		}
+		if (!(flags & KFIFO_CHAN_PARK)) {
+			sched_yield();
+			continue;
+		}
+		__atomic_store_n(&ring->parked, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		ret = kfifo_chan_get(ring, msgs, n);
+		if (!ret)
+			kfifo_chan_park(&ring->parked);
+		__atomic_store_n(&ring->parked, 0, __ATOMIC_RELAXED);
+		if (ret)
+			return ret;
+	}
+}
+
+int kfifo_chan_alloc(struct kfifo_chan *chan, unsigned int size, int flags)
+{
+	int ret;
+
+	chan->next_id = 1;
+	chan->flags = flags;
+	ret = kfifo_chan_ring_alloc(&chan->req, size);
+	if (ret)
+		return ret;
+	ret = kfifo_chan_ring_alloc(&chan->resp, size);
+	if (ret)
+		kfifo_chan_ring_free(&chan->req);
+	return ret;
+}
+
+void kfifo_chan_free(struct kfifo_chan *chan)
+{
+	kfifo_chan_ring_free(&chan->req);
+	kfifo_chan_ring_free(&chan->resp);
+}
+
+unsigned int kfifo_chan_send(struct kfifo_chan *chan,
+			     struct kfifo_msg *msgs, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		msgs[i].id = chan->next_id + i;
+	n = kfifo_chan_put(&chan->req, msgs, n, chan->flags);
+	chan->next_id += n;
+	return n;
+}
+
+unsigned int kfifo_chan_poll(struct kfifo_chan *chan,
+			     struct kfifo_msg *msgs, unsigned int n)
+{
+	return kfifo_chan_get(&chan->resp, msgs, n);
+}
+
+unsigned int kfifo_chan_wait(struct kfifo_chan *chan,
+			     struct kfifo_msg *msgs, unsigned int n)
+{
+	return kfifo_chan_wait_ring(&chan->resp, msgs, n, chan->flags);
+}
+
+unsigned int kfifo_chan_recv(struct kfifo_chan *chan,
+			     struct kfifo_msg *msgs, unsigned int n)
+{
+	return kfifo_chan_get(&chan->req, msgs, n);
+}
+
+unsigned int kfifo_chan_recv_wait(struct kfifo_chan *chan,
+				  struct kfifo_msg *msgs, unsigned int n)
+{
+	return kfifo_chan_wait_ring(&chan->req, msgs, n, chan->flags);
+}
+
+unsigned int kfifo_chan_reply(struct kfifo_chan *chan,
+			      const struct kfifo_msg *msgs, unsigned int n)
+{
+	return kfifo_chan_put(&chan->resp, msgs, n, chan->flags);
+}
@@ -0,0 +1,147 @@
+/*
+ * Duplex request/response channel on a pair of SPSC kfifos
+ */
+
+#ifndef _KFIFO_CHAN_H
+#define _KFIFO_CHAN_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * One client thread sends requests, one server thread receives them and
+ * sends the replies back; every message carries the id of the request it
+ * belongs to. Each direction is a kfifo-style ring with exactly one reader
+ * and one writer, so there is no lock and no atomic read-modify-write on the
+ * message path:
+ *
+ *  - the writer publishes in with a release store, the reader reads it
+ *    with an acquire load (and the same for out the other way),
+ *  - in and out are on separate cache lines, each next to its owner's copy
+ *    of the other index, and the buffer pointer and mask on a third line
+ *    that is only read,
+ *  - each side keeps a private copy of the other side's index and only
+ *    reloads it when the copy says the fifo is full (writer) or empty
+ *    (reader), so a cache line moves between the threads only when the
+ *    state actually changed,
+ *  - a batch of n messages costs one index store, not n.
+ *
+ * The waiting calls spin first. Without KFIFO_CHAN_PARK they then keep
+ * polling and yield the CPU between rounds; with it they sleep on a futex,
+ * and every send pays one full fence to check whether the peer sleeps.
+ */
+
+#define KFIFO_CHAN_PARK		0x1
+
+struct kfifo_msg {
+	unsigned long	id;	/* set by kfifo_chan_send(), echoed by the reply */
+	unsigned long	op;
+	void		*data;
+	unsigned long	len;
+};
+
+struct kfifo_chan_ring {
+	struct kfifo_msg	*data;
+	unsigned int		mask;
+	unsigned int		in ____cacheline_aligned;	/* writer */
+	unsigned int		out_cache;			/* writer's copy of out */
+	unsigned int		out ____cacheline_aligned;	/* reader */
+	unsigned int		in_cache;			/* reader's copy of in */
+	int			parked ____cacheline_aligned;	/* reader's futex word */
+};
+
+struct kfifo_chan {
+	int			flags;
+	struct kfifo_chan_ring	req;	/* client -> server */
+	struct kfifo_chan_ring	resp;	/* server -> client */
+	unsigned long		next_id ____cacheline_aligned;
+};
+
+/**
+ * kfifo_chan_alloc - allocate a channel
+ * @chan: the channel to initialize
+ * @size: number of messages per direction, rounded up to a power of 2
+ * @flags: 0 or KFIFO_CHAN_PARK
+ *
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_chan_alloc(struct kfifo_chan *chan, unsigned int size,
+	int flags);
+
+extern void kfifo_chan_free(struct kfifo_chan *chan);
+
+/**
+ * kfifo_chan_send - send requests, client side
+ * @chan: the channel to be used
+ * @msgs: the requests, their id fields are filled in
+ * @n: number of requests
+ *
+ * Return the number of requests sent, less than @n if the fifo is full.
+ */
+extern unsigned int kfifo_chan_send(struct kfifo_chan *chan,
+	struct kfifo_msg *msgs, unsigned int n);
+
+/**
+ * kfifo_chan_poll - get replies without waiting, client side
+ * @chan: the channel to be used
+ * @msgs: where to store the replies
+ * @n: maximum number of replies
+ *
+ * Return the number of replies stored.
+ */
+extern unsigned int kfifo_chan_poll(struct kfifo_chan *chan,
+	struct kfifo_msg *msgs, unsigned int n);
+
+/**
+ * kfifo_chan_wait - get replies, waiting for at least one, client side
+ * @chan: the channel to be used
+ * @msgs: where to store the replies
+ * @n: maximum number of replies, at least 1
+ *
+ * Return the number of replies stored.
+ */
+extern unsigned int kfifo_chan_wait(struct kfifo_chan *chan,
+	struct kfifo_msg *msgs, unsigned int n);
+
+/**
+ * kfifo_chan_recv - get requests without waiting, server side
+ * @chan: the channel to be used
+ * @msgs: where to store the requests
+ * @n: maximum number of requests
+ *
+ * Return the number of requests stored.
+ */
+extern unsigned int kfifo_chan_recv(struct kfifo_chan *chan,
+	struct kfifo_msg *msgs, unsigned int n);
+
+/**
+ * kfifo_chan_recv_wait - get requests, waiting for at least one, server side
+ * @chan: the channel to be used
+ * @msgs: where to store the requests
+ * @n: maximum number of requests, at least 1
+ *
+ * Return the number of requests stored.
+ */
+extern unsigned int kfifo_chan_recv_wait(struct kfifo_chan *chan,
+	struct kfifo_msg *msgs, unsigned int n);
+
+/**
+ * kfifo_chan_reply - send replies, server side
+ * @chan: the channel to be used
+ * @msgs: the replies, with the id of their request
+ * @n: number of replies
+ *
+ * Answer a whole kfifo_chan_recv() batch with one call, it is published at
+ * once. Return the number of replies sent, less than @n if the fifo is full.
+ */
+extern unsigned int kfifo_chan_reply(struct kfifo_chan *chan,
+	const struct kfifo_msg *msgs, unsigned int n);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * SPSC kfifo that grows and shrinks while in use
+ */
+
+#include "kfifo_dyn.h"
+
+/* the reader checks for an idle ring every that many kfifo_dyn_out() calls */
+#define KFIFO_DYN_SHRINK_PERIOD	4096
+
+static inline unsigned int roundup_pow_of_two(unsigned int v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v++;
+	return v;
+}
+
+static struct kfifo_dyn_ring *kfifo_dyn_ring_alloc(unsigned int size,
+						   size_t esize)
+{
+	struct kfifo_dyn_ring *ring = malloc(sizeof(*ring));
+
+	if (!ring)
+		return NULL;
+	if (__kfifo_alloc(&ring->fifo, size, esize)) {
+		free(ring);
+		return NULL;
+	}
+	ring->next = NULL;
+	return ring;
+}
+
+static void kfifo_dyn_ring_free(struct kfifo_dyn_ring *ring)
+{
+	__kfifo_free(&ring->fifo);
+	free(ring);
+}
+
+static inline unsigned int kfifo_dyn_ring_size(struct kfifo_dyn_ring *ring)
+{
+	return ring->fifo.mask + 1;
+}
+
+/*
+ * writer: link a new ring of @size behind the current one and move to it
+ */
+static struct kfifo_dyn_ring *kfifo_dyn_switch(struct kfifo_dyn *dyn,
+					       unsigned int size)
+{
+	struct kfifo_dyn_ring *ring = kfifo_dyn_ring_alloc(size, dyn->esize);
+
+	if (!ring)
+		return NULL;
+	__atomic_store_n(&dyn->tail->next, ring, __ATOMIC_RELEASE);
+	dyn->tail = ring;
+	return ring;
+}
+
+int kfifo_dyn_alloc(struct kfifo_dyn *dyn, unsigned int size,
+		    unsigned int min_size, unsigned int max_size, size_t esize)
+{
+	size = roundup_pow_of_two(size);
+	min_size = roundup_pow_of_two(min_size);
+	max_size = roundup_pow_of_two(max_size);
+
+	if (min_size < 2 || min_size > size || size > max_size)
+		return -EINVAL;
+
+	dyn->min_size = min_size;
+	dyn->max_size = max_size;
+	dyn->esize = esize;
+	dyn->shrink = 0;
+	dyn->peak = 0;
+	dyn->polls = 0;
+	dyn->tail = kfifo_dyn_ring_alloc(size, esize);
+	dyn->head = dyn->tail;
+	if (!dyn->tail)
+		return -ENOMEM;
+	return 0;
+}
+
+void kfifo_dyn_free(struct kfifo_dyn *dyn)
+{
+	struct kfifo_dyn_ring *ring = dyn->head, *next;
+
+	while (ring) {
+		next = ring->next;
+		kfifo_dyn_ring_free(ring);
+		ring = next;
+	}
+	dyn->head = NULL;
+	dyn->tail = NULL;
+}
+
+unsigned int kfifo_dyn_in(struct kfifo_dyn *dyn, const void *buf,
+			  unsigned int len)
+{
+	struct kfifo_dyn_ring *ring = dyn->tail;
+	unsigned int shrink = __atomic_load_n(&dyn->shrink, __ATOMIC_RELAXED);
+	unsigned int n, size;
+
+	if (shrink) {
+		if (shrink < kfifo_dyn_ring_size(ring) && kfifo_dyn_switch(dyn, shrink))
+			ring = dyn->tail;
+		/* a request posted since the load stays for the next call */
+		__atomic_compare_exchange_n(&dyn->shrink, &shrink, 0, 0,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+
+	n = __kfifo_in(&ring->fifo, buf, len);
+	if (n == len)
+		return n;
+
+	size = kfifo_dyn_ring_size(ring);
+	if (size >= dyn->max_size)
+		return n;
+	size *= 2;
+	while (size < dyn->max_size && size < len - n)
+		size *= 2;
+	if (size > dyn->max_size)
+		size = dyn->max_size;
+
+	ring = kfifo_dyn_switch(dyn, size);
+	if (!ring)
+		return n;
+	return n + __kfifo_in(&ring->fifo,
+			      (const unsigned char *)buf + n * dyn->esize, len - n);
+}
+
+/*
+ * reader: ask for a smaller ring when this one was never more than a quarter
+ * full during the last period
+ */
+static void kfifo_dyn_idle(struct kfifo_dyn *dyn, unsigned int len)
+{
+	struct kfifo_dyn_ring *ring = dyn->head;
+	unsigned int size = kfifo_dyn_ring_size(ring);
+
+	if (len > dyn->peak)
+		dyn->peak = len;
+	if (++dyn->polls < KFIFO_DYN_SHRINK_PERIOD)
+		return;
+
+	if (dyn->peak < size / 4 && size > dyn->min_size &&
+	    !__atomic_load_n(&ring->next, __ATOMIC_RELAXED))
+		kfifo_dyn_shrink(dyn, size / 2);
+	dyn->peak = 0;
+	dyn->polls = 0;
+}
+
+unsigned int kfifo_dyn_out(struct kfifo_dyn *dyn, void *buf, unsigned int len)
+{
+	struct kfifo_dyn_ring *ring = dyn->head, *next;
+	unsigned int n;
+
+	kfifo_dyn_idle(dyn, ring->fifo.in - ring->fifo.out);
+
+	n = __kfifo_out(&ring->fifo, buf, len);
+	while (n < len) {
+		next = __atomic_load_n(&ring->next, __ATOMIC_ACQUIRE);
+		if (!next)
+			break;
+		/* the writer is done with @ring, but it may have added more first */
+		n += __kfifo_out(&ring->fifo, (unsigned char *)buf + n * dyn->esize,
+				 len - n);
+		if (ring->fifo.in != ring->fifo.out)
+			break;
+		dyn->head = next;
+		kfifo_dyn_ring_free(ring);
+		ring = next;
+		n += __kfifo_out(&ring->fifo, (unsigned char *)buf + n * dyn->esize,
+				 len - n);
+	}
+	return n;
+}
+
+void kfifo_dyn_shrink(struct kfifo_dyn *dyn, unsigned int size)
+{
+	size = roundup_pow_of_two(size);
+	if (size < dyn->min_size)
+		size = dyn->min_size;
+	__atomic_store_n(&dyn->shrink, size, __ATOMIC_RELAXED);
+}
+
+unsigned int kfifo_dyn_len(struct kfifo_dyn *dyn)
+{
+	struct kfifo_dyn_ring *ring = dyn->head;
+	unsigned int len = 0;
+
+	while (ring) {
+		len += ring->fifo.in - ring->fifo.out;
+		ring = __atomic_load_n(&ring->next, __ATOMIC_ACQUIRE);
+	}
+	return len;
+}
+
+unsigned int kfifo_dyn_size(struct kfifo_dyn *dyn)
+{
+	return kfifo_dyn_ring_size(dyn->tail);
+}
@@ -0,0 +1,119 @@
+/*
+ * SPSC kfifo that grows and shrinks while in use
+ */
+
+#ifndef _KFIFO_DYN_H
+#define _KFIFO_DYN_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A kfifo_dyn is a chain of struct __kfifo rings with one reader and one
+ * writer. The writer only ever writes to the newest ring (tail), the reader
+ * only reads from the oldest one (head); in between there is normally
+ * nothing, during a resize there may be a few rings.
+ *
+ * Resizing never moves data and never stops either side. The writer
+ * allocates the new ring, links it behind the current one with a release
+ * store of ->next and from then on writes there. The reader drains the old
+ * ring, and once it sees ->next set and the old ring empty (the writer
+ * filled it before publishing ->next) it switches over and frees it. Element
+ * order is kept.
+ *
+ * Growing: kfifo_dyn_in() doubles the ring, up to max_size, when the data
+ * does not fit.
+ *
+ * Shrinking: the reader asks for it, either with kfifo_dyn_shrink() or by
+ * itself when the ring stayed below a quarter full for a while, and the
+ * writer does it on its next kfifo_dyn_in(). Not below min_size.
+ */
+
+struct kfifo_dyn_ring {
+	struct __kfifo		fifo;
+	struct kfifo_dyn_ring	*next;
+};
+
+struct kfifo_dyn {
+	struct kfifo_dyn_ring	*tail ____cacheline_aligned;	/* writer */
+	struct kfifo_dyn_ring	*head ____cacheline_aligned;	/* reader */
+	unsigned int		peak;
+	unsigned int		polls;
+	unsigned int		shrink ____cacheline_aligned;	/* requested size */
+	unsigned int		min_size;
+	unsigned int		max_size;
+	size_t			esize;
+};
+
+/**
+ * kfifo_dyn_alloc - allocate a resizable fifo
+ * @dyn: the fifo to initialize
+ * @size: initial number of elements
+ * @min_size: smallest size it may shrink to
+ * @max_size: largest size it may grow to
+ * @esize: size of an element
+ *
+ * All sizes are rounded up to a power of 2.
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_dyn_alloc(struct kfifo_dyn *dyn, unsigned int size,
+	unsigned int min_size, unsigned int max_size, size_t esize);
+
+extern void kfifo_dyn_free(struct kfifo_dyn *dyn);
+
+/**
+ * kfifo_dyn_in - put data into the fifo, growing it if needed
+ * @dyn: the fifo to be used
+ * @buf: the data to be added
+ * @len: number of elements to be added
+ *
+ * Writer only. Return the number of elements stored, less than @len only if
+ * the fifo is at max_size or memory ran out.
+ */
+extern unsigned int kfifo_dyn_in(struct kfifo_dyn *dyn, const void *buf,
+	unsigned int len);
+
+/**
+ * kfifo_dyn_out - get data from the fifo
+ * @dyn: the fifo to be used
+ * @buf: where to store the data
+ * @len: maximum number of elements
+ *
+ * Reader only. Return the number of elements copied.
+ */
+extern unsigned int kfifo_dyn_out(struct kfifo_dyn *dyn, void *buf,
+	unsigned int len);
+
+/**
+ * kfifo_dyn_shrink - ask the writer to switch to a smaller ring
+ * @dyn: the fifo to be used
+ * @size: the new size, rounded up to a power of 2 and at least min_size
+ *
+ * Reader only. Takes effect on the next kfifo_dyn_in().
+ */
+extern void kfifo_dyn_shrink(struct kfifo_dyn *dyn, unsigned int size);
+
+/**
+ * kfifo_dyn_len - returns the number of elements in the fifo
+ * @dyn: the fifo to be used
+ *
+ * Reader only.
+ */
+extern unsigned int kfifo_dyn_len(struct kfifo_dyn *dyn);
+
+/**
+ * kfifo_dyn_size - returns the size of the ring being written
+ * @dyn: the fifo to be used
+ *
+ * Writer only.
+ */
+extern unsigned int kfifo_dyn_size(struct kfifo_dyn *dyn);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Thread pool executor on per-worker kfifo task queues
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "kfifo_executor.h"
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#define KFIFO_WORKER_BATCH	32
+#define KFIFO_WORKER_SPINS	1000
+
+static void kfifo_park(int *word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)word;
+	sched_yield();
+#endif
+}
+
+static void kfifo_unpark(int *word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)word;
+#endif
+}
+
+static inline int kfifo_worker_empty(struct kfifo_worker *w)
+{
+	return __atomic_load_n(&w->queue.in, __ATOMIC_ACQUIRE) == w->queue.out;
+}
+
+static void kfifo_worker_wake(struct kfifo_worker *w)
+{
+	/* pairs with the fence in kfifo_worker_idle() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->parked, __ATOMIC_RELAXED) &&
+	    __atomic_exchange_n(&w->parked, 0, __ATOMIC_RELAXED))
+		kfifo_unpark(&w->parked);
+}
+
+/*
+ * nothing to do: spin for a while, then park until a submitter wakes us
+ */
+static void kfifo_worker_idle(struct kfifo_worker *w)
+{
+	unsigned int i;
+
+	for (i = 0; i < KFIFO_WORKER_SPINS; i++) {
+		if (!kfifo_worker_empty(w) ||
+		    __atomic_load_n(&w->ex->stop, __ATOMIC_ACQUIRE))
+			return;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	__atomic_store_n(&w->parked, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (kfifo_worker_empty(w) && !__atomic_load_n(&w->ex->stop, __ATOMIC_ACQUIRE))
+		kfifo_park(&w->parked);
+	__atomic_store_n(&w->parked, 0, __ATOMIC_RELAXED);
+}
+
+static void *kfifo_worker_main(void *arg)
+{
+	struct kfifo_worker *w = arg;
+	struct kfifo_task tasks[KFIFO_WORKER_BATCH];
+	unsigned int i, n;
+
+	for (;;) {
+		n = __kfifo_out(&w->queue, tasks, KFIFO_WORKER_BATCH);
+		for (i = 0; i < n; i++)
+			tasks[i].fn(tasks[i].arg);
+		if (n)
+			continue;
+		if (__atomic_load_n(&w->ex->stop, __ATOMIC_ACQUIRE) && kfifo_worker_empty(w))
+			break;
+		kfifo_worker_idle(w);
+	}
+	return NULL;
+}
+
+int kfifo_executor_start(struct kfifo_executor *ex, unsigned int nr,
+			 unsigned int queue_size, const int *cpus)
+{
+	struct kfifo_worker *w;
+	cpu_set_t set;
+	unsigned int i;
+	int ret;
+
+	if (!nr)
+		return -EINVAL;
+	if (posix_memalign((void **)&ex->workers, 64, nr * sizeof(*ex->workers)))
+		return -ENOMEM;
+	memset(ex->workers, 0, nr * sizeof(*ex->workers));
+	ex->nr = 0;
+	ex->next = 0;
+	ex->stop = 0;
+
+	for (i = 0; i < nr; i++) {
+		w = &ex->workers[i];
+		w->ex = ex;
+		w->cpu = cpus ? cpus[i] : -1;
+		ret = __kfifo_alloc(&w->queue, queue_size, sizeof(struct kfifo_task));
+		if (!ret)
+			ret = -pthread_create(&w->thread, NULL, kfifo_worker_main, w);
+		if (ret) {
+			__kfifo_free(&w->queue);
+			kfifo_executor_stop(ex);
+			return ret;
+		}
+		if (w->cpu >= 0) {
+			CPU_ZERO(&set);
+			CPU_SET(w->cpu, &set);
+			pthread_setaffinity_np(w->thread, sizeof(set), &set);
+		}
+		ex->nr++;
+	}
+	return 0;
+}
+
+void kfifo_executor_stop(struct kfifo_executor *ex)
+{
+	unsigned int i;
+
+	__atomic_store_n(&ex->stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < ex->nr; i++)
+		kfifo_worker_wake(&ex->workers[i]);
+	for (i = 0; i < ex->nr; i++) {
+		pthread_join(ex->workers[i].thread, NULL);
+		__kfifo_free(&ex->workers[i].queue);
+	}
+	free(ex->workers);
+	ex->workers = NULL;
+	ex->nr = 0;
+}
+
+static unsigned int kfifo_executor_put(struct kfifo_executor *ex,
+				       const struct kfifo_task *tasks,
+				       unsigned int n)
+{
+	unsigned int idx = __atomic_fetch_add(&ex->next, 1, __ATOMIC_RELAXED);
+	struct kfifo_worker *w = &ex->workers[idx % ex->nr];
+
+	while (__atomic_exchange_n(&w->lock, 1, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&w->lock, __ATOMIC_RELAXED))
+			sched_yield();
+	}
+	n = __kfifo_in(&w->queue, tasks, n);
+	__atomic_store_n(&w->lock, 0, __ATOMIC_RELEASE);
+
+	if (n)
+		kfifo_worker_wake(w);
+	return n;
+}
+
+int kfifo_executor_submit(struct kfifo_executor *ex,
+			  void (*fn)(void *arg), void *arg)
+{
+	struct kfifo_task task;
+
+	task.fn = fn;
+	task.arg = arg;
+	return kfifo_executor_put(ex, &task, 1) ? 0 : -EAGAIN;
+}
+
+unsigned int kfifo_executor_submit_batch(struct kfifo_executor *ex,
+					 const struct kfifo_task *tasks,
+					 unsigned int n)
+{
+	return kfifo_executor_put(ex, tasks, n);
+}
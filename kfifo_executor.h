@@ -0,0 +1,94 @@
+/*
+ * Thread pool executor on per-worker kfifo task queues
+ */
+
+#ifndef _KFIFO_EXECUTOR_H
+#define _KFIFO_EXECUTOR_H
+
+#include <pthread.h>
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every worker thread owns a kfifo of tasks and is its only reader.
+ * Submitters pick a worker round-robin and serialize on that worker's
+ * writer lock, as kfifo requires for multiple writers. An idle worker spins
+ * briefly, then parks on a futex; a submitter only makes the wake-up system
+ * call when the worker is actually parked.
+ */
+
+struct kfifo_task {
+	void	(*fn)(void *arg);
+	void	*arg;
+};
+
+struct kfifo_executor;
+
+struct kfifo_worker {
+	struct __kfifo		queue;
+	int			lock;		/* writer lock */
+	int			parked;		/* futex word */
+	pthread_t		thread;
+	int			cpu;
+	struct kfifo_executor	*ex;
+} ____cacheline_aligned;
+
+struct kfifo_executor {
+	struct kfifo_worker	*workers;
+	unsigned int		nr;
+	unsigned int		next;		/* round-robin cursor */
+	int			stop;
+};
+
+/**
+ * kfifo_executor_start - start a pool of worker threads
+ * @ex: the executor to initialize
+ * @nr: number of worker threads
+ * @queue_size: number of tasks per worker queue, rounded up to a power of 2
+ * @cpus: NULL, or @nr CPU numbers to pin the workers to (-1: don't pin)
+ *
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_executor_start(struct kfifo_executor *ex, unsigned int nr,
+	unsigned int queue_size, const int *cpus);
+
+/**
+ * kfifo_executor_stop - run the queued tasks and join the workers
+ * @ex: the executor to be stopped
+ *
+ * No task may be submitted concurrently or afterwards.
+ */
+extern void kfifo_executor_stop(struct kfifo_executor *ex);
+
+/**
+ * kfifo_executor_submit - queue one task
+ * @ex: the executor to be used
+ * @fn: the function to run on a worker thread
+ * @arg: the argument passed to @fn
+ *
+ * Return 0, or -EAGAIN if the chosen worker's queue is full.
+ */
+extern int kfifo_executor_submit(struct kfifo_executor *ex,
+	void (*fn)(void *arg), void *arg);
+
+/**
+ * kfifo_executor_submit_batch - queue many tasks at once
+ * @ex: the executor to be used
+ * @tasks: the tasks to be queued
+ * @n: number of tasks
+ *
+ * The tasks go to one worker with a single kfifo index update and at most
+ * one wake-up. Return the number of tasks queued, less than @n if that
+ * worker's queue is full.
+ */
+extern unsigned int kfifo_executor_submit_batch(struct kfifo_executor *ex,
+	const struct kfifo_task *tasks, unsigned int n);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
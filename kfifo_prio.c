@@ -0,0 +1,212 @@
+/*
+ * Priority queue made of one kfifo per priority level
+ */
+
+#include "kfifo_prio.h"
+#include <string.h>
+
+/* level/group i is bit 63 - i % 64, so that clz gives the lowest index */
+static inline unsigned long long kfifo_prio_bit(unsigned int i)
+{
+	return 1ull << (63 - (i & 63));
+}
+
+int kfifo_prio_alloc(struct kfifo_prio *pq, unsigned int nr,
+		     unsigned int size, size_t esize)
+{
+	unsigned int i;
+	int ret;
+
+	if (!nr || nr > KFIFO_PRIO_MAX)
+		return -EINVAL;
+
+	memset(pq, 0, sizeof(*pq));
+	pq->level = calloc(nr, sizeof(*pq->level));
+	pq->weight = calloc(nr, sizeof(*pq->weight));
+	pq->credit = calloc(nr, sizeof(*pq->credit));
+	pq->round = calloc(nr, sizeof(*pq->round));
+	if (!pq->level || !pq->weight || !pq->credit || !pq->round) {
+		kfifo_prio_free(pq);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr; i++) {
+		pq->weight[i] = 1;
+		ret = __kfifo_alloc(&pq->level[i], size, esize);
+		if (ret) {
+			kfifo_prio_free(pq);
+			return ret;
+		}
+		pq->nr++;
+	}
+	pq->cur_round = 1;
+	return 0;
+}
+
+void kfifo_prio_free(struct kfifo_prio *pq)
+{
+	unsigned int i;
+
+	for (i = 0; i < pq->nr; i++)
+		__kfifo_free(&pq->level[i]);
+	free(pq->level);
+	free(pq->weight);
+	free(pq->credit);
+	free(pq->round);
+	memset(pq, 0, sizeof(*pq));
+}
+
+void kfifo_prio_set_weight(struct kfifo_prio *pq, unsigned int level,
+			   unsigned int weight)
+{
+	pq->weight[level] = weight ? weight : 1;
+}
+
+unsigned int kfifo_prio_len(struct kfifo_prio *pq, unsigned int level)
+{
+	return pq->level[level].in - pq->level[level].out;
+}
+
+unsigned int kfifo_prio_in(struct kfifo_prio *pq, unsigned int level,
+			   const void *buf, unsigned int len)
+{
+	unsigned int w = level >> 6;
+
+	len = __kfifo_in(&pq->level[level], buf, len);
+	if (!len)
+		return 0;
+
+	/* publishes the data, pairs with the clear in kfifo_prio_empty() */
+	__atomic_fetch_or(&pq->map[w], kfifo_prio_bit(level), __ATOMIC_SEQ_CST);
+	if (!(__atomic_load_n(&pq->summary, __ATOMIC_SEQ_CST) & kfifo_prio_bit(w)))
+		__atomic_fetch_or(&pq->summary, kfifo_prio_bit(w), __ATOMIC_SEQ_CST);
+	return len;
+}
+
+/*
+ * reader: @level looked empty, clear its bits unless a put raced with us
+ */
+static void kfifo_prio_empty(struct kfifo_prio *pq, unsigned int level)
+{
+	unsigned int w = level >> 6;
+	unsigned long long old;
+
+	old = __atomic_fetch_and(&pq->map[w], ~kfifo_prio_bit(level), __ATOMIC_SEQ_CST);
+	if (kfifo_prio_len(pq, level)) {
+		__atomic_fetch_or(&pq->map[w], kfifo_prio_bit(level), __ATOMIC_SEQ_CST);
+		return;
+	}
+	if (old & ~kfifo_prio_bit(level))
+		return;
+
+	__atomic_fetch_and(&pq->summary, ~kfifo_prio_bit(w), __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&pq->map[w], __ATOMIC_SEQ_CST))
+		__atomic_fetch_or(&pq->summary, kfifo_prio_bit(w), __ATOMIC_SEQ_CST);
+}
+
+static unsigned int kfifo_prio_take(struct kfifo_prio *pq, unsigned int level,
+				    void *buf, unsigned int len)
+{
+	len = __kfifo_out(&pq->level[level], buf, len);
+	if (!kfifo_prio_len(pq, level))
+		kfifo_prio_empty(pq, level);
+	return len;
+}
+
+unsigned int kfifo_prio_out(struct kfifo_prio *pq, void *buf,
+			    unsigned int len, unsigned int *level)
+{
+	unsigned long long s, m;
+	unsigned int w, l, n;
+
+	/* a zero-length take would leave a ready level's bit set forever */
+	if (!len)
+		return 0;
+
+	for (;;) {
+		s = __atomic_load_n(&pq->summary, __ATOMIC_ACQUIRE);
+		if (!s)
+			return 0;
+		w = __builtin_clzll(s);
+		m = __atomic_load_n(&pq->map[w], __ATOMIC_ACQUIRE);
+		if (!m) {
+			/* stale summary bit, a reader clear is the fix */
+			__atomic_fetch_and(&pq->summary, ~kfifo_prio_bit(w), __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&pq->map[w], __ATOMIC_SEQ_CST))
+				__atomic_fetch_or(&pq->summary, kfifo_prio_bit(w), __ATOMIC_SEQ_CST);
+			continue;
+		}
+		l = (w << 6) + __builtin_clzll(m);
+		n = kfifo_prio_take(pq, l, buf, len);
+		if (n) {
+			if (level)
+				*level = l;
+			return n;
+		}
+		/* the level was empty and its bit is cleared now */
+	}
+}
+
+/*
+ * reader: the highest ready level that still has credit in this round
+ */
+static int kfifo_prio_pick(struct kfifo_prio *pq, unsigned int *level)
+{
+	unsigned long long s, m;
+	unsigned int w;
+
+	s = __atomic_load_n(&pq->summary, __ATOMIC_ACQUIRE);
+	while (s) {
+		w = __builtin_clzll(s);
+		m = __atomic_load_n(&pq->map[w], __ATOMIC_ACQUIRE) & ~pq->spent[w];
+		if (m) {
+			*level = (w << 6) + __builtin_clzll(m);
+			return 1;
+		}
+		s &= ~kfifo_prio_bit(w);
+	}
+	return 0;
+}
+
+unsigned int kfifo_prio_out_weighted(struct kfifo_prio *pq, void *buf,
+				     unsigned int len, unsigned int *level)
+{
+	unsigned int l, n;
+	int fresh = 0;
+
+	if (!len)
+		return 0;
+
+	for (;;) {
+		if (!kfifo_prio_pick(pq, &l)) {
+			if (!__atomic_load_n(&pq->summary, __ATOMIC_ACQUIRE))
+				return 0;
+			/* only stale bits left, kfifo_prio_out() clears them */
+			if (fresh)
+				return kfifo_prio_out(pq, buf, len, level);
+			/* every ready level used up its credit: next round */
+			pq->cur_round++;
+			memset(pq->spent, 0, sizeof(pq->spent));
+			fresh = 1;
+			continue;
+		}
+		if (pq->round[l] != pq->cur_round) {
+			pq->round[l] = pq->cur_round;
+			pq->credit[l] = pq->weight[l];
+		}
+		if (!pq->credit[l]) {
+			/* used up in this round, skip it until the next */
+			pq->spent[l >> 6] |= kfifo_prio_bit(l);
+			continue;
+		}
+		n = kfifo_prio_take(pq, l, buf, len < pq->credit[l] ? len : pq->credit[l]);
+		if (!n)
+			continue;
+		pq->credit[l] -= n;
+		if (!pq->credit[l])
+			pq->spent[l >> 6] |= kfifo_prio_bit(l);
+		if (level)
+			*level = l;
+		return n;
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * Priority queue made of one kfifo per priority level
+ */
+
+#ifndef _KFIFO_PRIO_H
+#define _KFIFO_PRIO_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Level 0 is the highest priority. Elements are FIFO within a level.
+ *
+ * A two-level bitmap records which levels are non-empty: bit 63 - (l % 64)
+ * of map[l / 64] for level l, and the same bit of summary for map[l / 64]
+ * being non-zero. Finding the highest ready level is two count-leading-zeros
+ * instructions, whatever the number of levels (at most KFIFO_PRIO_MAX).
+ *
+ * Note about locking: like a kfifo, one writer and one reader need no lock.
+ * The writer sets the bits after adding data, the reader clears them when it
+ * empties a level and then checks the level again, so a concurrent put is
+ * never lost. Several writers, or several readers, must serialize.
+ *
+ * kfifo_prio_out() is strict priority. kfifo_prio_out_weighted() lets each
+ * level take at most its weight in elements per round before the lower
+ * levels get their turn; a new round starts when no ready level has credit
+ * left, so a busy high level cannot starve the others. It skips the levels
+ * without credit word by word, at most 64 words.
+ */
+
+#define KFIFO_PRIO_MAX		(64 * 64)
+
+struct kfifo_prio {
+	struct __kfifo		*level;
+	unsigned int		nr;
+	unsigned long long	summary;
+	unsigned long long	map[64];
+	/* weighted draining, reader only */
+	unsigned int		*weight;
+	unsigned int		*credit;
+	unsigned int		*round;		/* round @credit belongs to */
+	unsigned int		cur_round;
+	unsigned long long	spent[64];	/* levels without credit */
+};
+
+/**
+ * kfifo_prio_alloc - allocate a priority queue
+ * @pq: the queue to initialize
+ * @nr: number of priority levels, at most KFIFO_PRIO_MAX
+ * @size: number of elements per level, rounded up to a power of 2
+ * @esize: size of an element
+ *
+ * All weights start at 1. Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_prio_alloc(struct kfifo_prio *pq, unsigned int nr,
+	unsigned int size, size_t esize);
+
+extern void kfifo_prio_free(struct kfifo_prio *pq);
+
+/**
+ * kfifo_prio_set_weight - set the share of a level for weighted draining
+ * @pq: the queue to be used
+ * @level: the priority level
+ * @weight: elements the level may take per round, at least 1
+ *
+ * Reader only.
+ */
+extern void kfifo_prio_set_weight(struct kfifo_prio *pq, unsigned int level,
+	unsigned int weight);
+
+/**
+ * kfifo_prio_in - put data into one level
+ * @pq: the queue to be used
+ * @level: the priority level
+ * @buf: the data to be added
+ * @len: number of elements to be added
+ *
+ * Return the number of elements stored.
+ */
+extern unsigned int kfifo_prio_in(struct kfifo_prio *pq, unsigned int level,
+	const void *buf, unsigned int len);
+
+/**
+ * kfifo_prio_out - get data from the highest non-empty level
+ * @pq: the queue to be used
+ * @buf: where to store the data
+ * @len: maximum number of elements
+ * @level: if not NULL, set to the level the data came from
+ *
+ * All elements returned by one call come from the same level.
+ * Return the number of elements copied.
+ */
+extern unsigned int kfifo_prio_out(struct kfifo_prio *pq, void *buf,
+	unsigned int len, unsigned int *level);
+
+/**
+ * kfifo_prio_out_weighted - like kfifo_prio_out(), honouring the weights
+ * @pq: the queue to be used
+ * @buf: where to store the data
+ * @len: maximum number of elements
+ * @level: if not NULL, set to the level the data came from
+ */
+extern unsigned int kfifo_prio_out_weighted(struct kfifo_prio *pq, void *buf,
+	unsigned int len, unsigned int *level);
+
+/**
+ * kfifo_prio_len - returns the number of elements in one level
+ * @pq: the queue to be used
+ * @level: the priority level
+ */
+extern unsigned int kfifo_prio_len(struct kfifo_prio *pq, unsigned int level);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * Unbounded queue made of fixed-size kfifo segments
+ */
+
+#include "kfifo_segq.h"
+#include <string.h>
+
+static inline unsigned int roundup_pow_of_two(unsigned int v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v++;
+	return v;
+}
+
+/*
+ * header and data in one allocation, the data starts on a cache line
+ */
+#define KFIFO_SEG_HDR	((sizeof(struct kfifo_seg) + 63) & ~(size_t)63)
+
+static void kfifo_seg_reset(struct kfifo_seg *seg)
+{
+	seg->fifo.in = 0;
+	seg->fifo.out = 0;
+	seg->next = NULL;
+	seg->claimed = 0;
+	seg->written = 0;
+	seg->retired = NULL;
+}
+
+static struct kfifo_seg *kfifo_seg_alloc(struct kfifo_segq *q)
+{
+	size_t bytes = q->seg_size * q->esize;
+	struct kfifo_seg *seg = malloc(KFIFO_SEG_HDR + bytes);
+
+	if (!seg)
+		return NULL;
+	__kfifo_init(&seg->fifo, (char *)seg + KFIFO_SEG_HDR, bytes, q->esize);
+	kfifo_seg_reset(seg);
+	return seg;
+}
+
+/*
+ * writer: a recycled segment if there is one, a new one otherwise. Several
+ * writers only try the pool when nobody else is at it, it is only an SPSC
+ * kfifo.
+ */
+static struct kfifo_seg *kfifo_seg_get(struct kfifo_segq *q, int mp)
+{
+	struct kfifo_seg *seg;
+	unsigned int n = 0;
+
+	if (!mp) {
+		n = __kfifo_out(&q->pool, &seg, 1);
+	} else if (!__atomic_exchange_n(&q->pool_lock, 1, __ATOMIC_ACQUIRE)) {
+		n = __kfifo_out(&q->pool, &seg, 1);
+		__atomic_store_n(&q->pool_lock, 0, __ATOMIC_RELEASE);
+	}
+	if (!n)
+		return kfifo_seg_alloc(q);
+	kfifo_seg_reset(seg);
+	return seg;
+}
+
+/*
+ * reader: give a drained segment back to the writer
+ */
+static void kfifo_seg_put(struct kfifo_segq *q, struct kfifo_seg *seg)
+{
+	if (!__kfifo_in(&q->pool, &seg, 1))
+		free(seg);
+}
+
+int kfifo_segq_alloc(struct kfifo_segq *q, unsigned int seg_size,
+		     size_t esize, unsigned int pool_size)
+{
+	int ret;
+
+	q->seg_size = roundup_pow_of_two(seg_size);
+	q->esize = esize;
+	q->active[0] = 0;
+	q->active[1] = 0;
+	q->epoch = 0;
+	q->pool_lock = 0;
+	q->retired = NULL;
+	q->grace = NULL;
+	if (q->seg_size < 2)
+		return -EINVAL;
+
+	ret = __kfifo_alloc(&q->pool, pool_size < 2 ? 2 : pool_size,
+			    sizeof(struct kfifo_seg *));
+	if (ret)
+		return ret;
+
+	q->tail = kfifo_seg_alloc(q);
+	q->head = q->tail;
+	if (!q->tail) {
+		__kfifo_free(&q->pool);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void kfifo_seg_free_list(struct kfifo_seg *seg)
+{
+	struct kfifo_seg *next;
+
+	while (seg) {
+		next = seg->retired;
+		free(seg);
+		seg = next;
+	}
+}
+
+void kfifo_segq_free(struct kfifo_segq *q)
+{
+	struct kfifo_seg *seg = q->head, *next;
+
+	while (seg) {
+		next = seg->next;
+		free(seg);
+		seg = next;
+	}
+	kfifo_seg_free_list(q->retired);
+	kfifo_seg_free_list(q->grace);
+	while (__kfifo_out(&q->pool, &seg, 1))
+		free(seg);
+	__kfifo_free(&q->pool);
+	q->head = NULL;
+	q->tail = NULL;
+	q->retired = NULL;
+	q->grace = NULL;
+}
+
+unsigned int kfifo_segq_in(struct kfifo_segq *q, const void *buf,
+			   unsigned int len)
+{
+	const unsigned char *p = buf;
+	struct kfifo_seg *seg;
+	unsigned int n = 0;
+
+	for (;;) {
+		n += __kfifo_in(&q->tail->fifo, p + n * q->esize, len - n);
+		if (n == len)
+			break;
+		seg = kfifo_seg_get(q, 0);
+		if (!seg)
+			break;
+		__atomic_store_n(&q->tail->next, seg, __ATOMIC_RELEASE);
+		q->tail = seg;
+	}
+	return n;
+}
+
+/*
+ * kfifo_segq_in_mp(): count the writer in the current epoch, the reader
+ * does not recycle what it may still see until it is out again
+ */
+static unsigned int kfifo_segq_enter(struct kfifo_segq *q)
+{
+	unsigned int e;
+
+	for (;;) {
+		e = __atomic_load_n(&q->epoch, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&q->active[e & 1], 1, __ATOMIC_SEQ_CST);
+		/* pairs with the epoch bump in kfifo_segq_reclaim() */
+		if (__atomic_load_n(&q->epoch, __ATOMIC_SEQ_CST) == e)
+			return e;
+		__atomic_fetch_sub(&q->active[e & 1], 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void kfifo_segq_exit(struct kfifo_segq *q, unsigned int e)
+{
+	__atomic_fetch_sub(&q->active[e & 1], 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * kfifo_segq_in_mp(): the segment after the full @seg, linked by whoever
+ * gets there first, and ->tail moved on to it
+ */
+static struct kfifo_seg *kfifo_seg_next(struct kfifo_segq *q,
+					struct kfifo_seg *seg)
+{
+	struct kfifo_seg *next = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
+	struct kfifo_seg *new, *cur = seg;
+
+	if (!next) {
+		new = kfifo_seg_get(q, 1);
+		if (!new)
+			return NULL;
+		if (__atomic_compare_exchange_n(&seg->next, &next, new, 0,
+						__ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+			next = new;
+		else
+			free(new);
+	}
+	__atomic_compare_exchange_n(&q->tail, &cur, next, 0,
+				    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	return next;
+}
+
+unsigned int kfifo_segq_in_mp(struct kfifo_segq *q, const void *buf,
+			      unsigned int len)
+{
+	const unsigned char *p = buf;
+	unsigned int size = q->seg_size;
+	unsigned int n = 0, cnt, e;
+	struct kfifo_seg *seg;
+	unsigned long pos;
+
+	e = kfifo_segq_enter(q);
+	seg = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+	while (n < len) {
+		/* at most a segment, so ->claimed cannot run away */
+		cnt = len - n < size ? len - n : size;
+		pos = __atomic_fetch_add(&seg->claimed, cnt, __ATOMIC_RELAXED);
+		if (pos < size) {
+			if (cnt > size - pos)
+				cnt = size - pos;
+			memcpy((unsigned char *)seg->fifo.data + pos * q->esize,
+			       p + n * q->esize, cnt * q->esize);
+			__atomic_fetch_add(&seg->written, cnt, __ATOMIC_RELEASE);
+			n += cnt;
+			if (n == len)
+				break;
+		}
+		seg = kfifo_seg_next(q, seg);
+		if (!seg)
+			break;
+	}
+	kfifo_segq_exit(q, e);
+	return n;
+}
+
+/*
+ * reader: with several writers fifo.in is the reader's own, moved up to
+ * ->written once every slot claimed in the segment is filled
+ */
+static unsigned int kfifo_seg_out(struct kfifo_seg *seg, void *buf,
+				  unsigned int len)
+{
+	unsigned int size = seg->fifo.mask + 1;
+	unsigned int w = __atomic_load_n(&seg->written, __ATOMIC_ACQUIRE);
+	unsigned long c = __atomic_load_n(&seg->claimed, __ATOMIC_RELAXED);
+
+	if (c && w == (c < size ? c : size))
+		seg->fifo.in = w;
+	return __kfifo_out(&seg->fifo, buf, len);
+}
+
+/*
+ * reader, @seg->next is set: a single writer is done with @seg, several may
+ * still be filling the slots they claimed
+ */
+static int kfifo_seg_drained(struct kfifo_seg *seg)
+{
+	if (seg->fifo.in != seg->fifo.out)
+		return 0;
+	return !__atomic_load_n(&seg->claimed, __ATOMIC_RELAXED) ||
+	       seg->fifo.out == seg->fifo.mask + 1;
+}
+
+/*
+ * reader: move ->tail off @seg so that new writers cannot find it, and keep
+ * it until the writers that might still hold it are gone
+ */
+static void kfifo_segq_retire(struct kfifo_segq *q, struct kfifo_seg *seg,
+			      struct kfifo_seg *next)
+{
+	struct kfifo_seg *cur = seg;
+
+	if (__atomic_load_n(&seg->claimed, __ATOMIC_RELAXED))
+		__atomic_compare_exchange_n(&q->tail, &cur, next, 0,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	seg->retired = q->retired;
+	q->retired = seg;
+}
+
+static void kfifo_segq_reclaim(struct kfifo_segq *q)
+{
+	struct kfifo_seg *seg;
+
+	if (q->grace) {
+		/* writers of the previous epoch may still hold these */
+		if (__atomic_load_n(&q->active[(q->epoch - 1) & 1], __ATOMIC_SEQ_CST))
+			return;
+		while ((seg = q->grace)) {
+			q->grace = seg->retired;
+			kfifo_seg_put(q, seg);
+		}
+	}
+	if (q->retired) {
+		q->grace = q->retired;
+		q->retired = NULL;
+		__atomic_store_n(&q->epoch, q->epoch + 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+unsigned int kfifo_segq_out(struct kfifo_segq *q, void *buf, unsigned int len)
+{
+	unsigned char *p = buf;
+	struct kfifo_seg *seg = q->head, *next;
+	unsigned int n;
+
+	if (q->grace || q->retired)
+		kfifo_segq_reclaim(q);
+
+	n = kfifo_seg_out(seg, p, len);
+	while (n < len) {
+		next = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
+		if (!next)
+			break;
+		/* the writers may have added more to @seg before linking @next */
+		n += kfifo_seg_out(seg, p + n * q->esize, len - n);
+		if (!kfifo_seg_drained(seg))
+			break;
+		q->head = next;
+		kfifo_segq_retire(q, seg, next);
+		seg = next;
+		n += kfifo_seg_out(seg, p + n * q->esize, len - n);
+	}
+	return n;
+}
+
+unsigned int kfifo_segq_len(struct kfifo_segq *q)
+{
+	struct kfifo_seg *seg = q->head;
+	unsigned int len = 0;
+
+	while (seg) {
+		if (__atomic_load_n(&seg->claimed, __ATOMIC_RELAXED))
+			len += __atomic_load_n(&seg->written, __ATOMIC_ACQUIRE) -
+			       seg->fifo.out;
+		else
+			len += seg->fifo.in - seg->fifo.out;
+		seg = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
+	}
+	return len;
+}
@@ -0,0 +1,133 @@
+/*
+ * Unbounded queue made of fixed-size kfifo segments
+ */
+
+#ifndef _KFIFO_SEGQ_H
+#define _KFIFO_SEGQ_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The queue is a singly linked chain of segments, each a struct __kfifo of
+ * seg_size elements. The writer fills the last segment; when it is full it
+ * takes a new one, links it with a release store of ->next and goes on
+ * there. The reader drains the first segment and, once it sees ->next set
+ * and the segment empty, moves on and hands the old segment back to the
+ * writer through a small SPSC kfifo of segment pointers (the pool). Once the
+ * pool holds enough segments for the usual queue depth nothing is allocated
+ * any more; segments that do not fit in the pool are freed.
+ *
+ * kfifo_segq_in() and kfifo_segq_out() need no lock with one writer and one
+ * reader.
+ *
+ * kfifo_segq_in_mp() takes any number of writers, also without a lock. The
+ * writers claim slots of the last segment with a fetch-add on ->claimed and
+ * count the slots they have copied in ->written; the reader only reads up to
+ * ->written once it equals the slots claimed in the segment, so a slot is
+ * never read before it is filled. A writer whose claim runs past the end of
+ * the segment links the next one with a compare-and-swap on ->next (the
+ * losers of that race free their segment) and moves ->tail on. A segment is
+ * drained once all of its slots are written and read.
+ *
+ * A writer may still hold a drained segment it loaded from ->tail before the
+ * reader left it. Writers therefore announce themselves in one of two
+ * counters, picked by the parity of ->epoch. The reader collects the
+ * segments it leaves, bumps the epoch, and recycles them only once the
+ * counter of the previous epoch has dropped to 0.
+ *
+ * A queue is written either with kfifo_segq_in() or with kfifo_segq_in_mp(),
+ * never with both.
+ *
+ * Pick seg_size so that a segment spans whole pages (or a huge page) for
+ * large queues, or a few cache lines for queues that are usually short.
+ */
+
+struct kfifo_seg {
+	struct __kfifo		fifo;
+	struct kfifo_seg	*next;
+	struct kfifo_seg	*retired;	/* reader's list of left segments */
+	/* kfifo_segq_in_mp() */
+	unsigned long		claimed ____cacheline_aligned;	/* may pass the end */
+	unsigned int		written;
+};
+
+struct kfifo_segq {
+	struct kfifo_seg	*tail ____cacheline_aligned;	/* writers */
+	unsigned long		active[2];	/* writers in kfifo_segq_in_mp() */
+	unsigned int		epoch;
+	int			pool_lock;	/* writers taking from the pool */
+	struct kfifo_seg	*head ____cacheline_aligned;	/* reader */
+	struct kfifo_seg	*retired;	/* left in the current epoch */
+	struct kfifo_seg	*grace;		/* left in the previous epoch */
+	struct __kfifo		pool;		/* free segments */
+	unsigned int		seg_size;
+	size_t			esize;
+};
+
+/**
+ * kfifo_segq_alloc - allocate an unbounded queue
+ * @q: the queue to initialize
+ * @seg_size: number of elements per segment, rounded up to a power of 2
+ * @esize: size of an element
+ * @pool_size: number of free segments kept for reuse
+ *
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_segq_alloc(struct kfifo_segq *q, unsigned int seg_size,
+	size_t esize, unsigned int pool_size);
+
+extern void kfifo_segq_free(struct kfifo_segq *q);
+
+/**
+ * kfifo_segq_in - put data into the queue, single writer
+ * @q: the queue to be used
+ * @buf: the data to be added
+ * @len: number of elements to be added
+ *
+ * Return the number of elements stored, less than @len only if memory ran
+ * out.
+ */
+extern unsigned int kfifo_segq_in(struct kfifo_segq *q, const void *buf,
+	unsigned int len);
+
+/**
+ * kfifo_segq_in_mp - put data into the queue, any number of writers
+ * @q: the queue to be used
+ * @buf: the data to be added
+ * @len: number of elements to be added
+ *
+ * The elements of one call stay in order, but a call that spills over into
+ * the next segment may be interleaved with other writers there. Return the
+ * number of elements stored, less than @len only if memory ran out.
+ */
+extern unsigned int kfifo_segq_in_mp(struct kfifo_segq *q,
+	const void *buf, unsigned int len);
+
+/**
+ * kfifo_segq_out - get data from the queue
+ * @q: the queue to be used
+ * @buf: where to store the data
+ * @len: maximum number of elements
+ *
+ * Reader only. Return the number of elements copied.
+ */
+extern unsigned int kfifo_segq_out(struct kfifo_segq *q, void *buf,
+	unsigned int len);
+
+/**
+ * kfifo_segq_len - returns the number of elements in the queue
+ * @q: the queue to be used
+ *
+ * Reader only.
+ */
+extern unsigned int kfifo_segq_len(struct kfifo_segq *q);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
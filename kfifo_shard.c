@@ -0,0 +1,143 @@
+/*
+ * Sharded kfifo set: one SPSC kfifo per producer, work-stealing consumers
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "kfifo_shard.h"
+#include <string.h>
+
+/*
+ * per-thread id, handed out on first use, never 0
+ */
+static __thread unsigned int kfifo_shard_tid;
+static unsigned int kfifo_shard_last_tid;
+
+static inline unsigned int kfifo_shard_self(void)
+{
+	if (!kfifo_shard_tid)
+		kfifo_shard_tid = __atomic_add_fetch(&kfifo_shard_last_tid, 1,
+						     __ATOMIC_RELAXED);
+	return kfifo_shard_tid;
+}
+
+int kfifo_shards_alloc(struct kfifo_shards *set, unsigned int nr,
+		       unsigned int size, size_t esize)
+{
+	unsigned int i;
+	int ret;
+
+	set->nr = 0;
+	if (!nr)
+		return -EINVAL;
+	if (posix_memalign((void **)&set->shard, 64, nr * sizeof(*set->shard)))
+		return -ENOMEM;
+	memset(set->shard, 0, nr * sizeof(*set->shard));
+
+	for (i = 0; i < nr; i++) {
+		ret = __kfifo_alloc(&set->shard[i].fifo, size, esize);
+		if (ret) {
+			set->nr = i;
+			kfifo_shards_free(set);
+			return ret;
+		}
+	}
+	set->nr = nr;
+	return 0;
+}
+
+void kfifo_shards_free(struct kfifo_shards *set)
+{
+	unsigned int i;
+
+	for (i = 0; i < set->nr; i++)
+		__kfifo_free(&set->shard[i].fifo);
+	free(set->shard);
+	set->shard = NULL;
+	set->nr = 0;
+}
+
+/*
+ * find the shard owned by the calling thread, claim one if there is none
+ */
+static struct kfifo_shard *kfifo_shards_home(struct kfifo_shards *set)
+{
+	unsigned int tid = kfifo_shard_self();
+	unsigned int i, owner;
+	struct kfifo_shard *shard;
+
+	for (i = 0; i < set->nr; i++) {
+		shard = &set->shard[(tid + i) % set->nr];
+		owner = __atomic_load_n(&shard->owner, __ATOMIC_ACQUIRE);
+		if (owner == tid)
+			return shard;
+		if (!owner &&
+		    __atomic_compare_exchange_n(&shard->owner, &owner, tid, 0,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return shard;
+	}
+	return NULL;
+}
+
+unsigned int kfifo_shards_in(struct kfifo_shards *set,
+			     const void *buf, unsigned int len)
+{
+	struct kfifo_shard *shard = kfifo_shards_home(set);
+
+	if (!shard)
+		return 0;
+	return __kfifo_in(&shard->fifo, buf, len);
+}
+
+void kfifo_shards_release(struct kfifo_shards *set)
+{
+	unsigned int tid = kfifo_shard_self();
+	unsigned int i;
+
+	for (i = 0; i < set->nr; i++) {
+		if (__atomic_load_n(&set->shard[i].owner, __ATOMIC_RELAXED) == tid)
+			__atomic_store_n(&set->shard[i].owner, 0, __ATOMIC_RELEASE);
+	}
+}
+
+static unsigned int kfifo_shard_try_out(struct kfifo_shard *shard,
+					void *buf, unsigned int len)
+{
+	unsigned int ret;
+
+	/* cheap check first, don't bounce the lock of an empty shard */
+	if (__atomic_load_n(&shard->fifo.in, __ATOMIC_ACQUIRE) ==
+	    __atomic_load_n(&shard->fifo.out, __ATOMIC_RELAXED))
+		return 0;
+	if (__atomic_exchange_n(&shard->busy, 1, __ATOMIC_ACQUIRE))
+		return 0;
+	ret = __kfifo_out(&shard->fifo, buf, len);
+	__atomic_store_n(&shard->busy, 0, __ATOMIC_RELEASE);
+	return ret;
+}
+
+unsigned int kfifo_shards_out(struct kfifo_shards *set,
+			      unsigned int home, void *buf, unsigned int len)
+{
+	unsigned int i, ret;
+
+	for (i = 0; i < set->nr; i++) {
+		ret = kfifo_shard_try_out(&set->shard[(home + i) % set->nr],
+					  buf, len);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+unsigned int kfifo_shards_len(struct kfifo_shards *set)
+{
+	unsigned int i, len = 0;
+
+	for (i = 0; i < set->nr; i++)
+		len += __atomic_load_n(&set->shard[i].fifo.in, __ATOMIC_RELAXED) -
+		       __atomic_load_n(&set->shard[i].fifo.out, __ATOMIC_RELAXED);
+	return len;
+}
@@ -0,0 +1,102 @@
+/*
+ * Sharded kfifo set: one SPSC kfifo per producer, work-stealing consumers
+ */
+
+#ifndef _KFIFO_SHARD_H
+#define _KFIFO_SHARD_H
+
+#include "kfifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A set of N struct __kfifo shards that looks like one queue.
+ *
+ * Producers: the first kfifo_shards_in() from a thread claims a shard for
+ * that thread (its home is thread id % N, the next free one if that is
+ * taken), after that the thread is the only writer of the shard and puts
+ * data in without any lock or atomic read-modify-write. Create the set with
+ * at least as many shards as there are producer threads; a thread that finds
+ * every shard claimed by others gets nothing stored.
+ *
+ * Consumers: kfifo_shards_out() drains the consumer's home shard and, when
+ * that is empty, steals a batch from the other shards. Consumers serialize
+ * per shard with a try-lock that is skipped when busy, so any number of
+ * consumers may run, and a single consumer never waits.
+ *
+ * Order is FIFO within a shard, not across shards.
+ */
+
+struct kfifo_shard {
+	struct __kfifo	fifo;
+	unsigned int	owner;		/* producer thread id, 0: unclaimed */
+	int		busy;		/* consumer try-lock */
+} ____cacheline_aligned;
+
+struct kfifo_shards {
+	struct kfifo_shard	*shard;
+	unsigned int		nr;
+};
+
+/**
+ * kfifo_shards_alloc - allocate a sharded fifo set
+ * @set: the set to initialize
+ * @nr: number of shards, one per producer thread
+ * @size: number of elements per shard, rounded up to a power of 2
+ * @esize: size of an element
+ *
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int kfifo_shards_alloc(struct kfifo_shards *set, unsigned int nr,
+	unsigned int size, size_t esize);
+
+extern void kfifo_shards_free(struct kfifo_shards *set);
+
+/**
+ * kfifo_shards_in - put data into the calling thread's shard
+ * @set: the set to be used
+ * @buf: the data to be added
+ * @len: number of elements to be added
+ *
+ * Return the number of elements stored.
+ */
+extern unsigned int kfifo_shards_in(struct kfifo_shards *set,
+	const void *buf, unsigned int len);
+
+/**
+ * kfifo_shards_release - give up the calling thread's shard
+ * @set: the set to be used
+ *
+ * Call it before a producer thread exits, so another thread can claim the
+ * shard. Elements still in the shard are kept.
+ */
+extern void kfifo_shards_release(struct kfifo_shards *set);
+
+/**
+ * kfifo_shards_out - get data from the set
+ * @set: the set to be used
+ * @home: the consumer's home shard, any number (taken modulo the shard count)
+ * @buf: pointer to the storage buffer
+ * @len: max. number of elements to get
+ *
+ * Drain @home first, then steal from the other shards in order. Return the
+ * number of elements copied, all of them come from the same shard.
+ */
+extern unsigned int kfifo_shards_out(struct kfifo_shards *set,
+	unsigned int home, void *buf, unsigned int len);
+
+/**
+ * kfifo_shards_len - returns the number of used elements in all shards
+ * @set: the set to be used
+ *
+ * Only a snapshot while producers and consumers are running.
+ */
+extern unsigned int kfifo_shards_len(struct kfifo_shards *set);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
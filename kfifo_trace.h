@@ -0,0 +1,45 @@
+/*
+ * Static USDT tracepoints for kfifo and ringbuf_t
+ */
+
+#ifndef _KFIFO_TRACE_H
+#define _KFIFO_TRACE_H
+
+/*
+ * Build with -DCONFIG_KFIFO_USDT to compile the probes in. That needs
+ * <sys/sdt.h> (systemtap-sdt-dev / systemtap-sdt-devel) at build time only,
+ * there is no runtime dependency: every probe is a single nop plus an ELF
+ * note describing where its arguments live, until a tracer attaches.
+ *
+ * Provider "kfifo", every probe gets the fifo address first:
+ *
+ *   kfifo:in      (fifo, len, used)	__kfifo_in() stored len elements
+ *   kfifo:out     (fifo, len, used)	__kfifo_out() removed len elements
+ *   kfifo:in_r    (fifo, len, used)	__kfifo_in_r() stored a len bytes record
+ *   kfifo:out_r   (fifo, len, used)	__kfifo_out_r() removed a len bytes record
+ *   kfifo:full    (fifo, len, used)	a put could not store all of len
+ *   kfifo:empty   (fifo)		a get found the fifo empty
+ *
+ * Provider "ringbuf", the same for ringbuf_in()/ringbuf_out():
+ *
+ *   ringbuf:in, ringbuf:out, ringbuf:full (self, len, used)
+ *   ringbuf:empty (self)
+ *
+ * `used` is the occupancy after the operation, in elements (bytes for record
+ * fifos). Example:
+ *
+ *   bpftrace -e 'usdt:./app:kfifo:full { @[arg0] = count(); }'
+ */
+
+#ifdef CONFIG_KFIFO_USDT
+	#include <sys/sdt.h>
+	#define KFIFO_TRACE1(provider, name, a) \
+		DTRACE_PROBE1(provider, name, a)
+	#define KFIFO_TRACE3(provider, name, a, b, c) \
+		DTRACE_PROBE3(provider, name, a, b, c)
+#else
+	#define KFIFO_TRACE1(provider, name, a) ((void)0)
+	#define KFIFO_TRACE3(provider, name, a, b, c) ((void)0)
+#endif
+
+#endif
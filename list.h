@@ -21,6 +21,7 @@
 
 // liigo 20200212
 #include <stdbool.h>
+#include <stddef.h>
 #ifdef __GNUC__
 	#define typeof __typeof__
 #endif
@@ -34,12 +35,30 @@
 #endif
 
 // liigo 20200212: see linux/compiler.h
-#define WRITE_ONCE(x, val)  do { (x) = (val); } while(0)
-#define READ_ONCE(x) (x)
+// volatile accesses: the compiler may not tear, fuse, re-read or drop them
+#ifndef READ_ONCE
+#define READ_ONCE(x)	(*(const volatile typeof(x) *)&(x))
+#endif
+#ifndef WRITE_ONCE
+#define WRITE_ONCE(x, val)	do { *(volatile typeof(x) *)&(x) = (val); } while (0)
+#endif
+
+// see asm-generic/barrier.h
+#ifndef smp_load_acquire
+#define smp_load_acquire(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#endif
+#ifndef smp_store_release
+#define smp_store_release(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#endif
+
+// see linux/prefetch.h
+#ifndef prefetch
+#define prefetch(x)	__builtin_prefetch(x)
+#endif
 
 // liigo 20200212: copy from linux/poison.h
-#define LIST_POISON1  ((char *) 0x100 + 0)
-#define LIST_POISON2  ((char *) 0x122 + 0)
+#define LIST_POISON1  ((void *) 0x100)
+#define LIST_POISON2  ((void *) 0x122)
 
 // liigo 20200212: copy from linux/types.h
 struct list_head {
@@ -61,7 +80,7 @@ struct hlist_node {
 static inline void INIT_LIST_HEAD(struct list_head *list)
 {
 	WRITE_ONCE(list->next, list);
-	list->prev = list;
+	WRITE_ONCE(list->prev, list);
 }
 
 #ifdef CONFIG_DEBUG_LIST
@@ -226,6 +245,24 @@ static inline void list_del_init(struct list_head *entry)
 	INIT_LIST_HEAD(entry);
 }
 
+/**
+ * list_del_init_careful - deletes entry from list and reinitialize it.
+ * @entry: the element to delete from the list.
+ *
+ * This is the same as list_del_init(), except designed to be used
+ * together with list_empty_careful() in a way to guarantee ordering
+ * of other memory operations.
+ *
+ * Any memory operations done before a list_del_init_careful() are
+ * guaranteed to be visible after a list_empty_careful() test.
+ */
+static inline void list_del_init_careful(struct list_head *entry)
+{
+	__list_del_entry(entry);
+	WRITE_ONCE(entry->prev, entry);
+	smp_store_release(&entry->next, entry);
+}
+
 /**
  * list_move - delete from one list and add as another's head
  * @list: the entry to move
@@ -318,8 +355,8 @@ static inline int list_empty(const struct list_head *head)
  */
 static inline int list_empty_careful(const struct list_head *head)
 {
-	struct list_head *next = head->next;
-	return (next == head) && (next == head->prev);
+	struct list_head *next = smp_load_acquire(&head->next);
+	return (next == head) && (next == READ_ONCE(head->prev));
 }
 
 /**
@@ -763,6 +800,82 @@ static inline void list_splice_tail_init(struct list_head *list,
 #define list_safe_reset_next(pos, n, member)				\
 	n = list_next_entry(pos, member)
 
+/*
+ * Prefetching iterators: a second cursor, @ahead, runs @dist nodes in front
+ * of @pos and prefetches the start of each entry it reaches. The links still
+ * have to be followed one by one (by @ahead instead of @pos), so a bare walk
+ * is no faster; what is gained is that the loop body's own misses on the
+ * entries overlap with the walk. Worth it on lists of cold entries that are
+ * larger than the caches, and only when the body touches the entry beyond
+ * its list_head.
+ *
+ * list_for_each_entry_prefetch() uses LIST_PREFETCH_DISTANCE and prefetches
+ * only when built with CONFIG_LIST_PREFETCH; otherwise it is a plain
+ * list_for_each_entry() and @ahead is unused.
+ */
+#ifndef LIST_PREFETCH_DISTANCE
+#define LIST_PREFETCH_DISTANCE	4
+#endif
+
+/* step @ahead one node further unless it is at @head, prefetch its entry */
+static inline struct list_head *__list_prefetch_next(struct list_head *ahead,
+		const struct list_head *head, size_t offset)
+{
+	if (ahead != head) {
+		ahead = ahead->next;
+		if (ahead != head)
+			prefetch((char *)ahead - offset);
+	}
+	return ahead;
+}
+
+static inline struct list_head *__list_prefetch_start(struct list_head *head,
+		unsigned int dist, size_t offset)
+{
+	struct list_head *ahead = head->next;
+
+	while (dist-- && ahead != head)
+		ahead = __list_prefetch_next(ahead, head, offset);
+	return ahead;
+}
+
+/**
+ * __list_for_each_entry_prefetch - iterate over list of given type, prefetching
+ * @pos:	the type * to use as a loop cursor.
+ * @ahead:	another &struct list_head to use as the prefetch cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ * @dist:	how many entries in front of @pos to prefetch.
+ */
+#define __list_for_each_entry_prefetch(pos, ahead, head, member, dist)	\
+	for (ahead = __list_prefetch_start(head, dist,			\
+			offsetof(typeof(*pos), member)),		\
+	     pos = list_first_entry(head, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     ahead = __list_prefetch_next(ahead, head,			\
+			offsetof(typeof(*pos), member)),		\
+	     pos = list_next_entry(pos, member))
+
+/**
+ * list_for_each_entry_prefetch - iterate over list of given type, prefetching
+ * LIST_PREFETCH_DISTANCE entries ahead if CONFIG_LIST_PREFETCH is set
+ * @pos:	the type * to use as a loop cursor.
+ * @ahead:	another &struct list_head to use as the prefetch cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ */
+#ifdef CONFIG_LIST_PREFETCH
+#define list_for_each_entry_prefetch(pos, ahead, head, member)		\
+	__list_for_each_entry_prefetch(pos, ahead, head, member,	\
+				       LIST_PREFETCH_DISTANCE)
+#else
+#define list_for_each_entry_prefetch(pos, ahead, head, member)		\
+	for (ahead = NULL, (void)ahead,					\
+	     pos = list_first_entry(head, typeof(*pos), member);	\
+	     &pos->member != (head);					\
+	     pos = list_next_entry(pos, member))
+#endif
+
 /*
  * Double linked lists with a single pointer list head.
  * Mostly useful for hash tables where the two pointer list head is
@@ -784,6 +897,19 @@ static inline int hlist_unhashed(const struct hlist_node *h)
 	return !h->pprev;
 }
 
+/**
+ * hlist_unhashed_lockless - Version of hlist_unhashed for lockless use
+ * @h: Node to be checked
+ *
+ * This variant of hlist_unhashed() must be used in lockless contexts
+ * to avoid potential load-tearing.  The READ_ONCE() is paired with the
+ * various WRITE_ONCE() in hlist helpers that are defined below.
+ */
+static inline int hlist_unhashed_lockless(const struct hlist_node *h)
+{
+	return !READ_ONCE(h->pprev);
+}
+
 static inline int hlist_empty(const struct hlist_head *h)
 {
 	return !READ_ONCE(h->first);
@@ -796,7 +922,7 @@ static inline void __hlist_del(struct hlist_node *n)
 
 	WRITE_ONCE(*pprev, next);
 	if (next)
-		next->pprev = pprev;
+		WRITE_ONCE(next->pprev, pprev);
 }
 
 static inline void hlist_del(struct hlist_node *n)
@@ -817,32 +943,32 @@ static inline void hlist_del_init(struct hlist_node *n)
 static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
 {
 	struct hlist_node *first = h->first;
-	n->next = first;
+	WRITE_ONCE(n->next, first);
 	if (first)
-		first->pprev = &n->next;
+		WRITE_ONCE(first->pprev, &n->next);
 	WRITE_ONCE(h->first, n);
-	n->pprev = &h->first;
+	WRITE_ONCE(n->pprev, &h->first);
 }
 
 /* next must be != NULL */
 static inline void hlist_add_before(struct hlist_node *n,
 					struct hlist_node *next)
 {
-	n->pprev = next->pprev;
-	n->next = next;
-	next->pprev = &n->next;
+	WRITE_ONCE(n->pprev, next->pprev);
+	WRITE_ONCE(n->next, next);
+	WRITE_ONCE(next->pprev, &n->next);
 	WRITE_ONCE(*(n->pprev), n);
 }
 
 static inline void hlist_add_behind(struct hlist_node *n,
 				    struct hlist_node *prev)
 {
-	n->next = prev->next;
-	prev->next = n;
-	n->pprev = &prev->next;
+	WRITE_ONCE(n->next, prev->next);
+	WRITE_ONCE(prev->next, n);
+	WRITE_ONCE(n->pprev, &prev->next);
 
 	if (n->next)
-		n->next->pprev  = &n->next;
+		WRITE_ONCE(n->next->pprev, &n->next);
 }
 
 /* after that we'll appear to be on some hlist and hlist_del will work */
@@ -935,4 +1061,65 @@ static inline void hlist_move_list(struct hlist_head *old,
 	     pos && ({ n = pos->member.next; 1; });			\
 	     pos = hlist_entry_safe(n, typeof(*pos), member))
 
+/* step @ahead one node further unless it is at the end, prefetch its entry */
+static inline struct hlist_node *__hlist_prefetch_next(struct hlist_node *ahead,
+		size_t offset)
+{
+	if (ahead) {
+		ahead = ahead->next;
+		if (ahead)
+			prefetch((char *)ahead - offset);
+	}
+	return ahead;
+}
+
+static inline struct hlist_node *__hlist_prefetch_start(struct hlist_head *head,
+		unsigned int dist, size_t offset)
+{
+	struct hlist_node *ahead = head->first;
+
+	while (dist-- && ahead)
+		ahead = __hlist_prefetch_next(ahead, offset);
+	return ahead;
+}
+
+/**
+ * __hlist_for_each_entry_prefetch - iterate over list of given type, prefetching
+ * @pos:	the type * to use as a loop cursor.
+ * @ahead:	another &struct hlist_node to use as the prefetch cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ * @dist:	how many entries in front of @pos to prefetch.
+ *
+ * See list_for_each_entry_prefetch() for when it helps.
+ */
+#define __hlist_for_each_entry_prefetch(pos, ahead, head, member, dist)	\
+	for (ahead = __hlist_prefetch_start(head, dist,			\
+			offsetof(typeof(*pos), member)),		\
+	     pos = hlist_entry_safe((head)->first, typeof(*(pos)), member);\
+	     pos;							\
+	     ahead = __hlist_prefetch_next(ahead,			\
+			offsetof(typeof(*pos), member)),		\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
+/**
+ * hlist_for_each_entry_prefetch - iterate over list of given type, prefetching
+ * LIST_PREFETCH_DISTANCE entries ahead if CONFIG_LIST_PREFETCH is set
+ * @pos:	the type * to use as a loop cursor.
+ * @ahead:	another &struct hlist_node to use as the prefetch cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#ifdef CONFIG_LIST_PREFETCH
+#define hlist_for_each_entry_prefetch(pos, ahead, head, member)		\
+	__hlist_for_each_entry_prefetch(pos, ahead, head, member,	\
+					LIST_PREFETCH_DISTANCE)
+#else
+#define hlist_for_each_entry_prefetch(pos, ahead, head, member)		\
+	for (ahead = NULL, (void)ahead,					\
+	     pos = hlist_entry_safe((head)->first, typeof(*(pos)), member);\
+	     pos;							\
+	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+#endif
+
 #endif
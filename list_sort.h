@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_LIST_SORT_H
+#define _LINUX_LIST_SORT_H
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int (*list_cmp_func_t)(void *,
+		const struct list_head *, const struct list_head *);
+
+extern void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * Sharded CLOCK cache of intrusive entries over list_head and RCU hlist buckets
+ */
+
+#include "lru_cache.h"
+#include "hashtable.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define LRU_CACHE_MIN_BUCKET_BITS	4
+
+/* log2 of x rounded up to a power of 2 */
+static inline unsigned int order_base_2(unsigned long x)
+{
+	unsigned int b;
+
+	for (b = 0; (1ul << b) < x; b++)
+		;
+	return b;
+}
+
+static inline void lru_shard_lock(struct lru_shard *shard)
+{
+	while (__atomic_exchange_n(&shard->lock, 1, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&shard->lock, __ATOMIC_RELAXED))
+			sched_yield();
+	}
+}
+
+static inline void lru_shard_unlock(struct lru_shard *shard)
+{
+	__atomic_store_n(&shard->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* the top bits of the hash pick the shard, the ones below them the bucket */
+static struct hlist_head *lru_bucket(struct lru_cache *cache, unsigned long key,
+				     struct lru_shard **shard)
+{
+	unsigned int h = hash_64(key, cache->shard_bits + cache->bucket_bits);
+
+	*shard = &cache->shards[h >> cache->bucket_bits];
+	return &(*shard)->table[h & ((1u << cache->bucket_bits) - 1)];
+}
+
+int lru_cache_init(struct lru_cache *cache, size_t capacity,
+		   unsigned int nr_shards, unsigned long nr_entries,
+		   lru_evict_func_t evict, void *priv)
+{
+	unsigned long per_shard;
+	unsigned int i, j;
+
+	if (!nr_shards || !capacity)
+		return -EINVAL;
+
+	cache->shard_bits = order_base_2(nr_shards);
+	per_shard = (nr_entries >> cache->shard_bits) + 1;
+	cache->bucket_bits = order_base_2(per_shard);
+	if (cache->bucket_bits < LRU_CACHE_MIN_BUCKET_BITS)
+		cache->bucket_bits = LRU_CACHE_MIN_BUCKET_BITS;
+	if (cache->shard_bits + cache->bucket_bits > 32)
+		return -EINVAL;
+	cache->evict = evict;
+	cache->priv = priv;
+
+	if (posix_memalign((void **)&cache->shards, 64,
+			   sizeof(*cache->shards) << cache->shard_bits))
+		return -ENOMEM;
+
+	for (i = 0; i < 1u << cache->shard_bits; i++) {
+		struct lru_shard *shard = &cache->shards[i];
+
+		shard->lock = 0;
+		INIT_LIST_HEAD(&shard->lru);
+		shard->bytes = 0;
+		shard->capacity = capacity >> cache->shard_bits;
+		shard->table = malloc(sizeof(*shard->table) << cache->bucket_bits);
+		if (!shard->table) {
+			while (i--)
+				free(cache->shards[i].table);
+			free(cache->shards);
+			cache->shards = NULL;
+			return -ENOMEM;
+		}
+		for (j = 0; j < 1u << cache->bucket_bits; j++)
+			INIT_HLIST_HEAD(&shard->table[j]);
+	}
+	return 0;
+}
+
+void lru_cache_exit(struct lru_cache *cache)
+{
+	struct lru_entry *pos, *n;
+	unsigned int i;
+
+	for (i = 0; i < 1u << cache->shard_bits; i++) {
+		struct lru_shard *shard = &cache->shards[i];
+
+		list_for_each_entry_safe(pos, n, &shard->lru, lru) {
+			hlist_del_init_rcu(&pos->hnode);
+			list_del_init(&pos->lru);
+			if (cache->evict)
+				cache->evict(pos, cache->priv);
+		}
+		free(shard->table);
+	}
+	free(cache->shards);
+	cache->shards = NULL;
+}
+
+/*
+ * shard locked: detach enough of the oldest unreferenced entries onto
+ * @victims to make room for @size more bytes, plus the slack. Runs before
+ * the new entry is added, so that it cannot be its own victim.
+ */
+static void lru_shard_evict(struct lru_shard *shard, size_t size,
+			    struct list_head *victims)
+{
+	struct lru_entry *e, *last = NULL, *wrap = NULL;
+	struct list_head *next;
+	size_t need, freed = 0;
+	int force = 0;
+
+	if (shard->bytes + size <= shard->capacity)
+		return;
+	need = shard->bytes + size - shard->capacity + shard->capacity / LRU_CACHE_SLACK;
+
+	while (freed < need) {
+		/* victims so far are the run at the head, up to @last */
+		next = last ? last->lru.next : shard->lru.next;
+		if (next == &shard->lru)
+			break;
+		e = list_entry(next, struct lru_entry, lru);
+		/*
+		 * lookups can mark a moved entry again without the lock, so
+		 * second chances end when the sweep gets back to the first one
+		 */
+		if (e == wrap)
+			force = 1;
+		if (!force && READ_ONCE(e->referenced)) {
+			WRITE_ONCE(e->referenced, 0);
+			if (!wrap)
+				wrap = e;
+			list_move_tail(&e->lru, &shard->lru);
+			continue;
+		}
+		last = e;
+		freed += e->size;
+	}
+	if (!last)
+		return;
+
+	list_cut_position(victims, &shard->lru, &last->lru);
+	list_for_each_entry(e, victims, lru)
+		hlist_del_init_rcu(&e->hnode);
+	shard->bytes -= freed;
+}
+
+int lru_cache_insert(struct lru_cache *cache, struct lru_entry *entry,
+		     unsigned long key, size_t size)
+{
+	struct lru_shard *shard;
+	struct hlist_head *head = lru_bucket(cache, key, &shard);
+	struct lru_entry *pos, *n;
+	LIST_HEAD(victims);
+
+	if (size > shard->capacity)
+		return -E2BIG;
+
+	entry->key = key;
+	entry->size = size;
+	entry->referenced = 0;
+
+	lru_shard_lock(shard);
+	hlist_for_each_entry(pos, head, hnode) {
+		if (pos->key == key) {
+			lru_shard_unlock(shard);
+			return -EEXIST;
+		}
+	}
+	lru_shard_evict(shard, size, &victims);
+	hlist_add_head_rcu(&entry->hnode, head);
+	list_add_tail(&entry->lru, &shard->lru);
+	shard->bytes += size;
+	lru_shard_unlock(shard);
+
+	list_for_each_entry_safe(pos, n, &victims, lru) {
+		INIT_LIST_HEAD(&pos->lru);
+		if (cache->evict)
+			cache->evict(pos, cache->priv);
+	}
+	return 0;
+}
+
+struct lru_entry *lru_cache_lookup(struct lru_cache *cache, unsigned long key)
+{
+	struct lru_shard *shard;
+	struct hlist_head *head = lru_bucket(cache, key, &shard);
+	struct lru_entry *e;
+
+	hlist_for_each_entry_rcu(e, head, hnode) {
+		if (e->key == key) {
+			if (!READ_ONCE(e->referenced))
+				WRITE_ONCE(e->referenced, 1);
+			return e;
+		}
+	}
+	return NULL;
+}
+
+int lru_cache_del(struct lru_cache *cache, struct lru_entry *entry)
+{
+	struct lru_shard *shard;
+
+	lru_bucket(cache, entry->key, &shard);
+	lru_shard_lock(shard);
+	/* unhashed under the lock: evicted, or deleted by someone else */
+	if (hlist_unhashed(&entry->hnode)) {
+		lru_shard_unlock(shard);
+		return 0;
+	}
+	hlist_del_init_rcu(&entry->hnode);
+	list_del_init(&entry->lru);
+	shard->bytes -= entry->size;
+	lru_shard_unlock(shard);
+	return 1;
+}
+
+size_t lru_cache_bytes(struct lru_cache *cache)
+{
+	size_t bytes = 0;
+	unsigned int i;
+
+	for (i = 0; i < 1u << cache->shard_bits; i++)
+		bytes += __atomic_load_n(&cache->shards[i].bytes, __ATOMIC_RELAXED);
+	return bytes;
+}
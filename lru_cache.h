@@ -0,0 +1,144 @@
+/*
+ * Sharded CLOCK cache of intrusive entries over list_head and RCU hlist buckets
+ */
+
+#ifndef _LRU_CACHE_H
+#define _LRU_CACHE_H
+
+#include "rculist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Keys are spread over 2^n shards. Each shard has its own lock, a fixed array
+ * of hlist buckets and a CLOCK list that is oldest first, and it holds
+ * capacity / 2^n bytes.
+ *
+ * Hits: lru_cache_lookup() walks the bucket under rcu_read_lock() and sets
+ * the entry's referenced bit (only if it is clear, so a hot entry's cache
+ * line stays clean). It takes no lock and does no list_move(). That makes
+ * the order an approximation of LRU, a second chance (CLOCK).
+ *
+ * Eviction runs in lru_cache_insert() when the new entry would not fit in
+ * the shard's share, before the entry is added, so a fresh entry is never
+ * its own victim. It frees LRU_CACHE_SLACK of the share more than is
+ * strictly needed so that it does not run on every insert. It walks the
+ * list from the oldest entry: a referenced entry loses its bit and goes to
+ * the tail; an unreferenced one joins the run of victims at the head.
+ * Lookups may set the bit again behind the sweep, so once it is back at the
+ * first entry it moved, it takes the rest as victims whatever their bit.
+ * The run is then detached with one list_cut_position() and unhashed. The
+ * evict callback is called for every victim after the shard lock is
+ * dropped.
+ *
+ * Lifetime: an entry that was deleted or evicted may still be in use by a
+ * reader in lru_cache_lookup() or inside its own read-side critical section.
+ * Free it with call_rcu() or after synchronize_rcu(). Threads that call
+ * lru_cache_lookup() must have called rcu_register_thread(); they are
+ * unregistered when they exit, or earlier with rcu_unregister_thread().
+ */
+
+#ifndef ____cacheline_aligned
+	#ifdef __GNUC__
+		#define ____cacheline_aligned __attribute__((__aligned__(64)))
+	#else
+		#define ____cacheline_aligned
+	#endif
+#endif
+
+#define LRU_CACHE_SLACK		32	/* evict 1/32 of a shard beyond the need */
+
+struct lru_entry {
+	struct hlist_node	hnode;
+	struct list_head	lru;
+	unsigned long		key;
+	size_t			size;
+	unsigned int		referenced;	/* set by lookups, cleared by the clock */
+};
+
+struct lru_shard {
+	int			lock;
+	struct list_head	lru;		/* oldest first */
+	struct hlist_head	*table;
+	size_t			bytes;
+	size_t			capacity;
+} ____cacheline_aligned;
+
+typedef void (*lru_evict_func_t)(struct lru_entry *entry, void *priv);
+
+struct lru_cache {
+	struct lru_shard	*shards;
+	unsigned int		shard_bits;
+	unsigned int		bucket_bits;	/* per shard */
+	lru_evict_func_t	evict;
+	void			*priv;
+};
+
+/**
+ * lru_cache_init - create an empty cache
+ * @cache: the cache to initialize
+ * @capacity: total size in bytes, as counted by the entries' @size
+ * @nr_shards: number of shards, rounded up to a power of 2
+ * @nr_entries: expected number of entries, sizes the bucket arrays
+ * @evict: called for every evicted entry, and for the rest by lru_cache_exit()
+ * @priv: passed to @evict
+ *
+ * Return 0 if no error, otherwise an error code.
+ */
+extern int lru_cache_init(struct lru_cache *cache, size_t capacity,
+	unsigned int nr_shards, unsigned long nr_entries,
+	lru_evict_func_t evict, void *priv);
+
+/**
+ * lru_cache_exit - evict every entry and free the shards
+ * @cache: the cache to be freed
+ */
+extern void lru_cache_exit(struct lru_cache *cache);
+
+/**
+ * lru_cache_insert - add an entry, evicting others if the shard is full
+ * @cache: the cache to be used
+ * @entry: the entry to be added, not in any cache
+ * @key: the key of @entry
+ * @size: the bytes @entry is accounted for
+ *
+ * Return 0 if no error, -EEXIST if @key is already cached, -E2BIG if @size
+ * is larger than a shard.
+ */
+extern int lru_cache_insert(struct lru_cache *cache, struct lru_entry *entry,
+	unsigned long key, size_t size);
+
+/**
+ * lru_cache_lookup - find the entry of a key and mark it referenced
+ * @cache: the cache to be used
+ * @key: the key to look up
+ *
+ * Call it inside rcu_read_lock(); the entry stays valid until the matching
+ * rcu_read_unlock(). Return the entry, or NULL on a miss.
+ */
+extern struct lru_entry *lru_cache_lookup(struct lru_cache *cache,
+	unsigned long key);
+
+/**
+ * lru_cache_del - remove an entry
+ * @cache: the cache to be used
+ * @entry: the entry to be removed
+ *
+ * The evict callback is not called. Return 1 if @entry was cached, 0 if it
+ * had been removed or evicted already.
+ */
+extern int lru_cache_del(struct lru_cache *cache, struct lru_entry *entry);
+
+/**
+ * lru_cache_bytes - returns the bytes in use, summed over the shards
+ * @cache: the cache to be used
+ */
+extern size_t lru_cache_bytes(struct lru_cache *cache);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
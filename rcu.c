@@ -0,0 +1,118 @@
+/*
+ * Minimal epoch-based RCU for user space
+ */
+
+#include "rcu.h"
+#include <pthread.h>
+#include <sched.h>
+
+unsigned long rcu_epoch = 1;
+__thread struct rcu_reader rcu_reader;
+
+static LIST_HEAD(rcu_readers);
+static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* unregisters a reader thread that exits without rcu_unregister_thread() */
+static pthread_key_t rcu_reader_key;
+static pthread_once_t rcu_reader_key_once = PTHREAD_ONCE_INIT;
+
+static struct rcu_head *rcu_pending;
+static unsigned int rcu_nr_pending;
+static pthread_mutex_t rcu_pending_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void rcu_reader_exit(void *arg)
+{
+	struct rcu_reader *r = arg;
+
+	pthread_mutex_lock(&rcu_registry_lock);
+	list_del_init(&r->node);
+	pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+static void rcu_reader_key_init(void)
+{
+	pthread_key_create(&rcu_reader_key, rcu_reader_exit);
+}
+
+void rcu_register_thread(void)
+{
+	rcu_reader.epoch = 0;
+	rcu_reader.nesting = 0;
+	pthread_mutex_lock(&rcu_registry_lock);
+	list_add(&rcu_reader.node, &rcu_readers);
+	pthread_mutex_unlock(&rcu_registry_lock);
+
+	/* the destructor runs while the thread's rcu_reader is still there */
+	pthread_once(&rcu_reader_key_once, rcu_reader_key_init);
+	pthread_setspecific(rcu_reader_key, &rcu_reader);
+}
+
+void rcu_unregister_thread(void)
+{
+	pthread_setspecific(rcu_reader_key, NULL);
+	rcu_reader_exit(&rcu_reader);
+}
+
+void synchronize_rcu(void)
+{
+	struct rcu_reader *r;
+	unsigned long epoch, e;
+
+	pthread_mutex_lock(&rcu_registry_lock);
+	/* the unlinking stores are visible before the scan, pairs with rcu_read_lock() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	epoch = __atomic_add_fetch(&rcu_epoch, 1, __ATOMIC_SEQ_CST);
+
+	list_for_each_entry(r, &rcu_readers, node) {
+		for (;;) {
+			e = __atomic_load_n(&r->epoch, __ATOMIC_ACQUIRE);
+			if (!e || e >= epoch)
+				break;
+			sched_yield();
+		}
+	}
+	pthread_mutex_unlock(&rcu_registry_lock);
+}
+
+static void rcu_run(struct rcu_head *head)
+{
+	struct rcu_head *next;
+
+	while (head) {
+		next = head->next;
+		head->func(head);
+		head = next;
+	}
+}
+
+void rcu_barrier(void)
+{
+	struct rcu_head *list;
+
+	pthread_mutex_lock(&rcu_pending_lock);
+	list = rcu_pending;
+	rcu_pending = NULL;
+	rcu_nr_pending = 0;
+	pthread_mutex_unlock(&rcu_pending_lock);
+
+	if (!list)
+		return;
+	synchronize_rcu();
+	rcu_run(list);
+}
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+	int full;
+
+	head->func = func;
+	pthread_mutex_lock(&rcu_pending_lock);
+	head->next = rcu_pending;
+	rcu_pending = head;
+	full = ++rcu_nr_pending >= RCU_BATCH;
+	pthread_mutex_unlock(&rcu_pending_lock);
+
+	/* not from inside a read-side critical section, it would wait for itself */
+	if (full && !rcu_reader.nesting)
+		rcu_barrier();
+}
@@ -0,0 +1,105 @@
+/*
+ * Minimal epoch-based RCU for user space
+ */
+
+#ifndef _RCU_H
+#define _RCU_H
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Readers: a thread calls rcu_register_thread() once, then brackets its
+ * lookups with rcu_read_lock()/rcu_read_unlock(). Entering a read-side
+ * critical section stores the current global epoch into the thread's own
+ * struct rcu_reader (its own cache line) and issues a full fence; nothing
+ * shared is written, so readers scale with the number of cores. A thread
+ * that exits is taken off the registry automatically, rcu_unregister_thread()
+ * does it earlier.
+ *
+ * Writers: unlink the element with the *_rcu list primitives (serialized
+ * among writers by their own lock), then either synchronize_rcu(), which
+ * bumps the epoch and waits until every reader is outside a critical section
+ * or has entered one after the bump, and free it; or hand it to call_rcu(),
+ * which queues it and runs the callbacks of a whole batch after one
+ * synchronize_rcu(). rcu_barrier() runs everything still queued.
+ *
+ * synchronize_rcu() must not be called inside a read-side critical section.
+ */
+
+#ifndef ____cacheline_aligned
+	#ifdef __GNUC__
+		#define ____cacheline_aligned __attribute__((__aligned__(64)))
+	#else
+		#define ____cacheline_aligned
+	#endif
+#endif
+
+#define RCU_BATCH	64	/* call_rcu() callbacks per grace period */
+
+struct rcu_head {
+	struct rcu_head	*next;
+	void		(*func)(struct rcu_head *head);
+};
+
+struct rcu_reader {
+	unsigned long		epoch;		/* 0: not reading */
+	unsigned int		nesting;
+	struct list_head	node;		/* on the registry */
+} ____cacheline_aligned;
+
+extern unsigned long rcu_epoch;
+extern __thread struct rcu_reader rcu_reader;
+
+/**
+ * rcu_dereference - fetch an RCU-protected pointer for dereferencing
+ * @p: the pointer to read
+ */
+#define rcu_dereference(p)	__atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+/**
+ * rcu_assign_pointer - publish a pointer to an initialized structure
+ * @p: the pointer to be assigned to
+ * @v: the value to assign
+ */
+#define rcu_assign_pointer(p, v)	__atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * RCU_INIT_POINTER - assign a pointer without ordering
+ * @p: the pointer to be assigned to
+ * @v: the value, NULL or something readers cannot see yet
+ */
+#define RCU_INIT_POINTER(p, v)	__atomic_store_n(&(p), (v), __ATOMIC_RELAXED)
+
+static inline void rcu_read_lock(void)
+{
+	if (rcu_reader.nesting++)
+		return;
+	__atomic_store_n(&rcu_reader.epoch,
+			 __atomic_load_n(&rcu_epoch, __ATOMIC_RELAXED),
+			 __ATOMIC_RELAXED);
+	/* pairs with the fence in synchronize_rcu() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void rcu_read_unlock(void)
+{
+	if (--rcu_reader.nesting)
+		return;
+	__atomic_store_n(&rcu_reader.epoch, 0, __ATOMIC_RELEASE);
+}
+
+extern void rcu_register_thread(void);
+extern void rcu_unregister_thread(void);
+extern void synchronize_rcu(void);
+extern void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+extern void rcu_barrier(void);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif
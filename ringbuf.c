@@ -1,9 +1,17 @@
 #include "ringbuf.h"
+#include "kfifo_trace.h"
 #include <assert.h>
+#include <stddef.h>
+#include <limits.h>
 
 // a ring buffer
 // a simple copy of kfifo (removing usage of typeof, which is not available in ANSI C )
 // by liigo, 20220224.
+//
+// ringbuf_in() is the producer side and only writes `in`; ringbuf_out() is the
+// consumer side and only writes `out`. Each side reads the other's index once,
+// followed by an acquire fence, and publishes its own index after a release
+// fence, see the memory ordering hooks in ringbuf.h.
 
 void* memcpy(void *dest, const void *src, size_t bytes);
 
@@ -22,7 +30,7 @@ void ringbuf_init(struct ringbuf_t *self, unsigned int item_size, void *buf, uns
 
 // item count in buf
 unsigned int ringbuf_len(struct ringbuf_t *self) {
-    return self->in - self->out;
+    return RINGBUF_READ_INDEX(self->in) - RINGBUF_READ_INDEX(self->out);
 };
 
 // max item count in buf
@@ -40,7 +48,7 @@ int ringbuf_is_full(struct ringbuf_t *self) {
 };
 
 int ringbuf_is_empty(struct ringbuf_t *self) {
-    return self->in == self->out;
+    return RINGBUF_READ_INDEX(self->in) == RINGBUF_READ_INDEX(self->out);
 };
 
 #define mymin(a, b) ((a)<(b)?(a):(b))
@@ -63,13 +71,21 @@ static void ringbuf_copy_in(struct ringbuf_t *self, const void *src, unsigned in
 }
 
 unsigned int ringbuf_in(struct ringbuf_t *self, const void *buf, unsigned int item_count) {
-    unsigned int avail = ringbuf_avail(self);
-    if (item_count > avail)
+    unsigned int in = self->in;
+    unsigned int avail = ringbuf_cap(self) - (in - RINGBUF_READ_INDEX(self->out));
+    // don't overwrite items before the consumer has finished copying them
+    RINGBUF_ACQUIRE_FENCE();
+    if (item_count > avail) {
+        KFIFO_TRACE3(ringbuf, full, self, item_count, ringbuf_cap(self) - avail);
         item_count = avail;
-    
-    ringbuf_copy_in(self, buf, item_count, self->in);
-    
-    self->in += item_count;
+    }
+
+    ringbuf_copy_in(self, buf, item_count, in);
+
+    // make sure the items are written before they are published
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->in, in + item_count);
+    KFIFO_TRACE3(ringbuf, in, self, item_count, ringbuf_cap(self) - avail + item_count);
     return item_count;
 }
 
@@ -92,7 +108,9 @@ static void ringbuf_copy_out(struct ringbuf_t *self, void *dst, unsigned int len
 
 unsigned int ringbuf_out_peek(struct ringbuf_t *self, void *buf, unsigned int len) {
 	unsigned int l;
-	l = self->in - self->out;
+	l = RINGBUF_READ_INDEX(self->in) - self->out;
+	// don't read items before the producer has published them
+	RINGBUF_ACQUIRE_FENCE();
 	if (len > l)
 		len = l;
 	ringbuf_copy_out(self, buf, len, self->out);
@@ -100,7 +118,165 @@ unsigned int ringbuf_out_peek(struct ringbuf_t *self, void *buf, unsigned int le
 }
 
 unsigned int ringbuf_out(struct ringbuf_t *self, void *buf, unsigned int item_count) {
+    unsigned int want = item_count;
     item_count = ringbuf_out_peek(self, buf, item_count);
-    self->out += item_count;
+    // make sure the items are copied before the slots are handed back
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->out, self->out + item_count);
+    if (want && !item_count)
+        KFIFO_TRACE1(ringbuf, empty, self);
+    KFIFO_TRACE3(ringbuf, out, self, item_count, RINGBUF_READ_INDEX(self->in) - self->out);
     return item_count;
 }
+
+void *ringbuf_peek_ptr(struct ringbuf_t *self, unsigned int *item_count) {
+    unsigned int off = self->out & self->mask;
+    unsigned int len = RINGBUF_READ_INDEX(self->in) - self->out;
+    RINGBUF_ACQUIRE_FENCE();
+    *item_count = mymin(len, self->mask + 1 - off);
+    return *item_count ? self->data + off * self->esize : NULL;
+}
+
+unsigned int ringbuf_read_spans(struct ringbuf_t *self, struct ringbuf_span spans[2]) {
+    unsigned int off = self->out & self->mask;
+    unsigned int len = RINGBUF_READ_INDEX(self->in) - self->out;
+    RINGBUF_ACQUIRE_FENCE();
+    spans[0].data = self->data + off * self->esize;
+    spans[0].len = mymin(len, self->mask + 1 - off);
+    spans[1].data = self->data;
+    spans[1].len = len - spans[0].len;
+    return len;
+}
+
+void ringbuf_consume(struct ringbuf_t *self, unsigned int item_count) {
+    assert(item_count <= RINGBUF_READ_INDEX(self->in) - self->out);
+    // make sure the items are read before the slots are handed back
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->out, self->out + item_count);
+}
+
+void *ringbuf_reserve(struct ringbuf_t *self, unsigned int *item_count) {
+    unsigned int off = self->in & self->mask;
+    unsigned int avail = ringbuf_cap(self) - (self->in - RINGBUF_READ_INDEX(self->out));
+    // don't hand out slots before the consumer has finished reading them
+    RINGBUF_ACQUIRE_FENCE();
+    *item_count = mymin(avail, self->mask + 1 - off);
+    return *item_count ? self->data + off * self->esize : NULL;
+}
+
+void ringbuf_commit(struct ringbuf_t *self, unsigned int item_count) {
+    assert(item_count <= ringbuf_cap(self) - (self->in - RINGBUF_READ_INDEX(self->out)));
+    // make sure the items are written before they are published
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->in, self->in + item_count);
+}
+
+#if UINT_MAX >= 0xffffffffUL
+typedef unsigned int ringbuf_u32;
+#else
+typedef unsigned long ringbuf_u32;
+#endif
+
+unsigned int ringbuf_max_rec(unsigned int recsize) {
+    if (recsize >= sizeof(unsigned int))
+        return UINT_MAX;
+    return (1u << (recsize << 3)) - 1;
+}
+
+// read the record header at `out` with a single 1/2/4 byte load,
+// unless the header wraps around the end of the buffer
+static unsigned int ringbuf_peek_n(struct ringbuf_t *self, unsigned int recsize) {
+    unsigned int off = self->out & self->mask;
+    const unsigned char *p = self->data + off;
+    unsigned char hdr[4];
+    unsigned short v16;
+    ringbuf_u32 v32;
+
+    if (off + recsize > self->mask + 1) {
+        ringbuf_copy_out(self, hdr, recsize, self->out);
+        p = hdr;
+    }
+    switch (recsize) {
+    case 1:
+        return *p;
+    case 2:
+        memcpy(&v16, p, 2);
+        return v16;
+    default:
+        memcpy(&v32, p, 4);
+        return (unsigned int)v32;
+    }
+}
+
+// store the record header at `in`, see ringbuf_peek_n()
+static void ringbuf_poke_n(struct ringbuf_t *self, unsigned int n, unsigned int recsize) {
+    unsigned int off = self->in & self->mask;
+    unsigned char *p = self->data + off;
+    unsigned char hdr[4];
+    unsigned short v16;
+    ringbuf_u32 v32;
+
+    if (off + recsize > self->mask + 1)
+        p = hdr;
+    switch (recsize) {
+    case 1:
+        *p = (unsigned char)n;
+        break;
+    case 2:
+        v16 = (unsigned short)n;
+        memcpy(p, &v16, 2);
+        break;
+    default:
+        v32 = n;
+        memcpy(p, &v32, 4);
+        break;
+    }
+    if (p == hdr)
+        ringbuf_copy_in(self, hdr, recsize, self->in);
+}
+
+static int ringbuf_recsize_valid(struct ringbuf_t *self, unsigned int recsize) {
+    assert(self->esize == 1);
+    return recsize == 1 || recsize == 2 || recsize == 4;
+}
+
+unsigned int ringbuf_in_rec(struct ringbuf_t *self, const void *buf, unsigned int len, unsigned int recsize) {
+    unsigned int in = self->in;
+    unsigned int avail = ringbuf_cap(self) - (in - RINGBUF_READ_INDEX(self->out));
+    RINGBUF_ACQUIRE_FENCE();
+    if (!ringbuf_recsize_valid(self, recsize) || len > ringbuf_max_rec(recsize))
+        return 0;
+    if (recsize > avail || len > avail - recsize)
+        return 0;
+
+    ringbuf_poke_n(self, len, recsize);
+    ringbuf_copy_in(self, buf, len, in + recsize);
+
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->in, in + recsize + len);
+    return len;
+}
+
+unsigned int ringbuf_peek_len(struct ringbuf_t *self, unsigned int recsize) {
+    if (!ringbuf_recsize_valid(self, recsize) || RINGBUF_READ_INDEX(self->in) == self->out)
+        return 0;
+    RINGBUF_ACQUIRE_FENCE();
+    return ringbuf_peek_n(self, recsize);
+}
+
+unsigned int ringbuf_out_rec(struct ringbuf_t *self, void *buf, unsigned int len, unsigned int recsize) {
+    unsigned int n;
+
+    if (!ringbuf_recsize_valid(self, recsize) || RINGBUF_READ_INDEX(self->in) == self->out)
+        return 0;
+    RINGBUF_ACQUIRE_FENCE();
+
+    n = ringbuf_peek_n(self, recsize);
+    if (len > n)
+        len = n;
+    ringbuf_copy_out(self, buf, len, self->out + recsize);
+
+    RINGBUF_RELEASE_FENCE();
+    RINGBUF_WRITE_INDEX(self->out, self->out + recsize + n);
+    return len;
+}
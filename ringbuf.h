@@ -6,6 +6,62 @@ struct ringbuf_t {
     unsigned int in, out, mask, esize;
 };
 
+// a contiguous region inside ringbuf_t.data
+struct ringbuf_span {
+    unsigned char *data;
+    unsigned int len; // item count
+};
+
+// Memory ordering hooks.
+//
+// With one producer and one consumer (two threads, or an ISR and the main
+// loop) ringbuf_in()/ringbuf_out() are lock-free: each side only writes its
+// own index, publishes it with a release fence and reads the other side's
+// index followed by an acquire fence. The fences are picked in this order:
+//
+//   1. user-provided RINGBUF_ACQUIRE_FENCE() / RINGBUF_RELEASE_FENCE()
+//   2. C11 <stdatomic.h> atomic_thread_fence()
+//   3. GCC/clang __atomic builtins, or __sync_synchronize() on older GCC
+//
+// Volatile index access alone is not enough, even on a single-core MCU where
+// the only concurrency is an interrupt handler: the payload memcpy() is not
+// volatile, so the compiler may still move it past the index store. Without
+// any of the above the build fails; such targets define the hooks, where a
+// compiler barrier is enough for an ISR on the same core.
+//
+// Define RINGBUF_NO_BARRIER to get the original barrier-free behaviour
+// (single-threaded use only).
+#if defined(RINGBUF_NO_BARRIER)
+    #undef RINGBUF_ACQUIRE_FENCE
+    #undef RINGBUF_RELEASE_FENCE
+    #define RINGBUF_ACQUIRE_FENCE() ((void)0)
+    #define RINGBUF_RELEASE_FENCE() ((void)0)
+    #define RINGBUF_READ_INDEX(x) (x)
+    #define RINGBUF_WRITE_INDEX(x, val) ((x) = (val))
+#elif !defined(RINGBUF_ACQUIRE_FENCE) || !defined(RINGBUF_RELEASE_FENCE)
+    #if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+        #include <stdatomic.h>
+        #define RINGBUF_ACQUIRE_FENCE() atomic_thread_fence(memory_order_acquire)
+        #define RINGBUF_RELEASE_FENCE() atomic_thread_fence(memory_order_release)
+    #elif defined(__ATOMIC_ACQUIRE)
+        #define RINGBUF_ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+        #define RINGBUF_RELEASE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+    #elif defined(__GNUC__)
+        #define RINGBUF_ACQUIRE_FENCE() __sync_synchronize()
+        #define RINGBUF_RELEASE_FENCE() __sync_synchronize()
+    #else
+        #error "ringbuf: no memory barrier, define RINGBUF_ACQUIRE_FENCE() and RINGBUF_RELEASE_FENCE()"
+    #endif
+#endif
+
+// Index accessors: volatile, so the compiler can neither cache nor tear them.
+#ifndef RINGBUF_READ_INDEX
+    #define RINGBUF_READ_INDEX(x) (*(volatile unsigned int *)&(x))
+#endif
+#ifndef RINGBUF_WRITE_INDEX
+    #define RINGBUF_WRITE_INDEX(x, val) (*(volatile unsigned int *)&(x) = (val))
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,10 +80,43 @@ unsigned int ringbuf_avail(struct ringbuf_t *self);
 int ringbuf_is_full(struct ringbuf_t *self);
 int ringbuf_is_empty(struct ringbuf_t *self);
 
+// Note that with only one concurrent reader and one concurrent writer,
+// you don't need extra locking to use these functions.
 unsigned int ringbuf_in(struct ringbuf_t *self, const void *buf, unsigned int item_count);
 unsigned int ringbuf_out(struct ringbuf_t *self, void *buf, unsigned int item_count);
 unsigned int ringbuf_out_peek(struct ringbuf_t *self, void *buf, unsigned int len);
 
+// Zero-copy access, the items stay in place inside self->data.
+//
+// Reader side: ringbuf_peek_ptr() returns the first readable items and stores
+// how many of them are contiguous into *item_count (NULL and 0 if empty).
+// ringbuf_read_spans() fills up to two spans covering everything readable and
+// returns the total item count. Release the items with ringbuf_consume().
+void *ringbuf_peek_ptr(struct ringbuf_t *self, unsigned int *item_count);
+unsigned int ringbuf_read_spans(struct ringbuf_t *self, struct ringbuf_span spans[2]);
+void ringbuf_consume(struct ringbuf_t *self, unsigned int item_count);
+
+// Writer side: ringbuf_reserve() returns the first free slot and stores how
+// many contiguous items may be written there into *item_count (NULL and 0 if
+// full). ringbuf_commit() publishes the first item_count of them.
+void *ringbuf_reserve(struct ringbuf_t *self, unsigned int *item_count);
+void ringbuf_commit(struct ringbuf_t *self, unsigned int item_count);
+
+// Record mode, the equivalent of kfifo_rec: variable-length records, each
+// prefixed by its length in a header of `recsize` bytes (1, 2 or 4).
+// The ring buffer must be initialized with item_size 1, and all calls on
+// it must use the same recsize.
+//
+// ringbuf_in_rec() stores the whole record or nothing, and returns len or 0.
+// ringbuf_out_rec() copies at most len bytes of the next record, removes the
+// record (the rest of a longer record is dropped), and returns the copied
+// byte count. ringbuf_peek_len() returns the length of the next record, 0 if
+// the buffer is empty. ringbuf_max_rec() is the largest storable length.
+unsigned int ringbuf_in_rec(struct ringbuf_t *self, const void *buf, unsigned int len, unsigned int recsize);
+unsigned int ringbuf_out_rec(struct ringbuf_t *self, void *buf, unsigned int len, unsigned int recsize);
+unsigned int ringbuf_peek_len(struct ringbuf_t *self, unsigned int recsize);
+unsigned int ringbuf_max_rec(unsigned int recsize);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
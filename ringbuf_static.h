@@ -0,0 +1,136 @@
+#ifndef RINGBUF_STATIC_H
+#define RINGBUF_STATIC_H
+
+// Header-only, type-specific ring buffers with a compile-time capacity.
+//
+// RINGBUF_DEFINE(name, type, cap) emits `struct name` holding `cap` items of
+// `type` plus a set of name_xxx() functions that work like ringbuf_xxx() in
+// ringbuf.c, but with the mask and item size known to the compiler: the index
+// wrap folds into an AND with a constant and the copies into moves of a fixed
+// size. No typeof is needed, so it works with the same ANSI compilers as
+// ringbuf_t. The same SPSC rules and memory ordering hooks apply (ringbuf.h).
+//
+//     RINGBUF_DEFINE(bytes, unsigned char, 256);
+//
+//     static struct bytes rx;
+//     bytes_init(&rx);
+//     bytes_put(&rx, &c);
+//     n = bytes_out(&rx, buf, sizeof(buf));
+//
+// `cap` must be a power of 2, anything else fails to compile.
+
+#include <string.h>
+#include "ringbuf.h"
+
+#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+    #define RINGBUF_INLINE static inline
+#elif defined(__GNUC__)
+    #define RINGBUF_INLINE static __inline__
+#else
+    #define RINGBUF_INLINE static
+#endif
+
+#define RINGBUF_DEFINE(name, type, cap) \
+typedef char name##_cap_must_be_power_of_2[((cap) < 2 || ((cap) & ((cap) - 1))) ? -1 : 1]; \
+\
+struct name { \
+    unsigned int in, out; \
+    type data[cap]; \
+}; \
+\
+RINGBUF_INLINE void name##_init(struct name *self) { \
+    self->in = self->out = 0; \
+} \
+\
+/* item count in buf */ \
+RINGBUF_INLINE unsigned int name##_len(struct name *self) { \
+    return RINGBUF_READ_INDEX(self->in) - RINGBUF_READ_INDEX(self->out); \
+} \
+\
+/* max item count in buf */ \
+RINGBUF_INLINE unsigned int name##_cap(struct name *self) { \
+    (void)self; \
+    return (cap); \
+} \
+\
+/* avail item count */ \
+RINGBUF_INLINE unsigned int name##_avail(struct name *self) { \
+    return (cap) - name##_len(self); \
+} \
+\
+RINGBUF_INLINE int name##_is_full(struct name *self) { \
+    return name##_len(self) >= (cap); \
+} \
+\
+RINGBUF_INLINE int name##_is_empty(struct name *self) { \
+    return RINGBUF_READ_INDEX(self->in) == RINGBUF_READ_INDEX(self->out); \
+} \
+\
+/* put a single item, returns 0 if the buffer is full */ \
+RINGBUF_INLINE int name##_put(struct name *self, const type *val) { \
+    unsigned int in = self->in; \
+    if (in - RINGBUF_READ_INDEX(self->out) >= (cap)) \
+        return 0; \
+    RINGBUF_ACQUIRE_FENCE(); \
+    self->data[in & ((cap) - 1)] = *val; \
+    RINGBUF_RELEASE_FENCE(); \
+    RINGBUF_WRITE_INDEX(self->in, in + 1); \
+    return 1; \
+} \
+\
+/* get a single item, returns 0 if the buffer is empty */ \
+RINGBUF_INLINE int name##_get(struct name *self, type *val) { \
+    unsigned int out = self->out; \
+    if (RINGBUF_READ_INDEX(self->in) == out) \
+        return 0; \
+    RINGBUF_ACQUIRE_FENCE(); \
+    *val = self->data[out & ((cap) - 1)]; \
+    RINGBUF_RELEASE_FENCE(); \
+    RINGBUF_WRITE_INDEX(self->out, out + 1); \
+    return 1; \
+} \
+\
+RINGBUF_INLINE unsigned int name##_in(struct name *self, const type *buf, unsigned int item_count) { \
+    unsigned int in = self->in; \
+    unsigned int avail = (cap) - (in - RINGBUF_READ_INDEX(self->out)); \
+    unsigned int off = in & ((cap) - 1); \
+    unsigned int l; \
+    RINGBUF_ACQUIRE_FENCE(); \
+    if (item_count > avail) \
+        item_count = avail; \
+    l = (cap) - off; \
+    if (l > item_count) \
+        l = item_count; \
+    memcpy(self->data + off, buf, l * sizeof(type)); \
+    memcpy(self->data, buf + l, (item_count - l) * sizeof(type)); \
+    RINGBUF_RELEASE_FENCE(); \
+    RINGBUF_WRITE_INDEX(self->in, in + item_count); \
+    return item_count; \
+} \
+\
+RINGBUF_INLINE unsigned int name##_out_peek(struct name *self, type *buf, unsigned int item_count) { \
+    unsigned int out = self->out; \
+    unsigned int len = RINGBUF_READ_INDEX(self->in) - out; \
+    unsigned int off = out & ((cap) - 1); \
+    unsigned int l; \
+    RINGBUF_ACQUIRE_FENCE(); \
+    if (item_count > len) \
+        item_count = len; \
+    l = (cap) - off; \
+    if (l > item_count) \
+        l = item_count; \
+    memcpy(buf, self->data + off, l * sizeof(type)); \
+    memcpy(buf + l, self->data, (item_count - l) * sizeof(type)); \
+    return item_count; \
+} \
+\
+RINGBUF_INLINE unsigned int name##_out(struct name *self, type *buf, unsigned int item_count) { \
+    item_count = name##_out_peek(self, buf, item_count); \
+    RINGBUF_RELEASE_FENCE(); \
+    RINGBUF_WRITE_INDEX(self->out, self->out + item_count); \
+    return item_count; \
+} \
+\
+typedef struct name name##_t
+
+#endif // RINGBUF_STATIC_H
@@ -0,0 +1,161 @@
+/*
+ * Hierarchical timer wheel over hlist, in the style of the kernel's timer_list
+ */
+
+#include "timer_wheel.h"
+
+/* tv1 slot that one of the levels above cascades from at the current tick */
+#define INDEX(wheel, n)	\
+	(((wheel)->clk >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+static inline bool time_after_eq(unsigned long a, unsigned long b)
+{
+	return (long)(a - b) >= 0;
+}
+
+void timer_wheel_init(struct timer_wheel *wheel, unsigned long now)
+{
+	unsigned int i, j;
+
+	wheel->clk = now;
+	wheel->count = 0;
+	for (i = 0; i < TVR_SIZE / 64; i++)
+		wheel->busy[i] = 0;
+	for (i = 0; i < TVR_SIZE; i++)
+		INIT_HLIST_HEAD(&wheel->tv1[i]);
+	for (i = 0; i < TVN_LEVELS; i++)
+		for (j = 0; j < TVN_SIZE; j++)
+			INIT_HLIST_HEAD(&wheel->tvn[i][j]);
+}
+
+static void internal_add_timer(struct timer_wheel *wheel,
+			       struct timer_list *timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - wheel->clk;
+	struct hlist_head *vec;
+	unsigned int i, level;
+
+	if ((long)idx < 0) {
+		/* already due: the slot that is run next */
+		i = wheel->clk & TVR_MASK;
+		vec = &wheel->tv1[i];
+		wheel->busy[i >> 6] |= 1ull << (i & 63);
+	} else if (idx < TVR_SIZE) {
+		i = expires & TVR_MASK;
+		vec = &wheel->tv1[i];
+		wheel->busy[i >> 6] |= 1ull << (i & 63);
+	} else {
+		if (idx > MAX_TVAL) {
+			idx = MAX_TVAL;
+			expires = idx + wheel->clk;
+		}
+		for (level = 0; level < TVN_LEVELS - 1; level++)
+			if (idx < 1ul << (TVR_BITS + (level + 1) * TVN_BITS))
+				break;
+		i = (expires >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK;
+		vec = &wheel->tvn[level][i];
+	}
+	hlist_add_head(&timer->entry, vec);
+}
+
+void timer_wheel_add(struct timer_wheel *wheel, struct timer_list *timer,
+		     unsigned long expires)
+{
+	timer->expires = expires;
+	internal_add_timer(wheel, timer);
+	wheel->count++;
+}
+
+int timer_wheel_del(struct timer_wheel *wheel, struct timer_list *timer)
+{
+	if (!timer_pending(timer))
+		return 0;
+	/* the slot's busy bit stays, timer_wheel_run() finds it empty */
+	hlist_del_init(&timer->entry);
+	wheel->count--;
+	return 1;
+}
+
+int timer_wheel_mod(struct timer_wheel *wheel, struct timer_list *timer,
+		    unsigned long expires)
+{
+	int ret = timer_wheel_del(wheel, timer);
+
+	timer_wheel_add(wheel, timer, expires);
+	return ret;
+}
+
+/* spread one slot of @level over the levels below */
+static unsigned int cascade(struct timer_wheel *wheel, unsigned int level,
+			    unsigned int index)
+{
+	struct timer_list *timer;
+	struct hlist_node *tmp;
+	HLIST_HEAD(tv_list);
+
+	hlist_move_list(&wheel->tvn[level][index], &tv_list);
+	hlist_for_each_entry_safe(timer, tmp, &tv_list, entry)
+		internal_add_timer(wheel, timer);
+	return index;
+}
+
+/* first tv1 slot from @index on that may hold timers, TVR_SIZE if none */
+static unsigned int next_busy(struct timer_wheel *wheel, unsigned int index)
+{
+	unsigned int w = index >> 6;
+	unsigned long long bits = wheel->busy[w] & (~0ull << (index & 63));
+
+	for (;;) {
+		if (bits)
+			return (w << 6) + __builtin_ctzll(bits);
+		if (++w == TVR_SIZE / 64)
+			return TVR_SIZE;
+		bits = wheel->busy[w];
+	}
+}
+
+unsigned long timer_wheel_run(struct timer_wheel *wheel, unsigned long now)
+{
+	struct timer_list *timer;
+	unsigned long expired = 0;
+	unsigned int index, next, level;
+	HLIST_HEAD(work_list);
+
+	while (time_after_eq(now, wheel->clk)) {
+		if (!wheel->count) {
+			wheel->clk = now + 1;
+			break;
+		}
+
+		index = wheel->clk & TVR_MASK;
+		if (!index) {
+			for (level = 0; level < TVN_LEVELS; level++)
+				if (cascade(wheel, level, INDEX(wheel, level)))
+					break;
+		} else {
+			/* jump over empty slots, but not past @now nor a wrap */
+			next = next_busy(wheel, index);
+			if (next != index) {
+				if (now - wheel->clk < next - index) {
+					wheel->clk = now + 1;
+					break;
+				}
+				wheel->clk += next - index;
+				continue;
+			}
+		}
+
+		wheel->clk++;
+		wheel->busy[index >> 6] &= ~(1ull << (index & 63));
+		hlist_move_list(&wheel->tv1[index], &work_list);
+		while (!hlist_empty(&work_list)) {
+			timer = hlist_entry(work_list.first, struct timer_list, entry);
+			hlist_del_init(&timer->entry);
+			wheel->count--;
+			expired++;
+			timer->function(timer);
+		}
+	}
+	return expired;
+}
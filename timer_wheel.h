@@ -0,0 +1,137 @@
+/*
+ * Hierarchical timer wheel over hlist, in the style of the kernel's timer_list
+ */
+
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This is the cascading wheel of the 2.6 kernels. Time is counted in ticks of
+ * whatever unit the caller picks. The first level has TVR_SIZE slots of one
+ * tick each. Each of the TVN_LEVELS levels above it has TVN_SIZE slots, and a
+ * slot there covers a whole turn of the level below. Timers further out than
+ * the wheel covers (2^32 ticks) are clamped to its end.
+ *
+ * A slot is an hlist_head. Adding a timer is one hlist_add_head() into a
+ * slot found by shifting and masking. Cancelling is one hlist_del_init(), and
+ * the timer does not need to know which slot it is in. When the first level
+ * wraps around, the current slot of the next level is "cascaded": its timers
+ * are spread over the level below. Every timer is moved at most TVN_LEVELS
+ * times in its life, and most timers are cancelled long before that.
+ *
+ * Expiry is batched per tick. timer_wheel_run() detaches the whole slot with
+ * hlist_move_list() and only then calls the callbacks, so a callback may add,
+ * modify or cancel any timer, itself included. Ticks whose first-level slot
+ * is empty are skipped with a bitmap instead of being walked one by one.
+ *
+ * There is no locking, a wheel that is used by several threads needs a lock
+ * around every call.
+ */
+
+#define TVN_BITS	6
+#define TVR_BITS	8
+#define TVN_SIZE	(1 << TVN_BITS)
+#define TVR_SIZE	(1 << TVR_BITS)
+#define TVN_MASK	(TVN_SIZE - 1)
+#define TVR_MASK	(TVR_SIZE - 1)
+#define TVN_LEVELS	4
+#define MAX_TVAL	((1ul << (TVR_BITS + TVN_LEVELS * TVN_BITS)) - 1)
+
+struct timer_list {
+	struct hlist_node	entry;
+	unsigned long		expires;
+	void			(*function)(struct timer_list *);
+};
+
+struct timer_wheel {
+	unsigned long		clk;		/* next tick to be run */
+	unsigned long		count;		/* pending timers */
+	unsigned long long	busy[TVR_SIZE / 64];	/* tv1 slots that may be non-empty */
+	struct hlist_head	tv1[TVR_SIZE];
+	struct hlist_head	tvn[TVN_LEVELS][TVN_SIZE];
+};
+
+#define from_timer(var, callback_timer, timer_fieldname) \
+	container_of(callback_timer, typeof(*var), timer_fieldname)
+
+/**
+ * timer_setup - prepare a timer for first use
+ * @timer: the timer to be initialized
+ * @callback: the function to call when the timer expires
+ */
+static inline void timer_setup(struct timer_list *timer,
+			       void (*callback)(struct timer_list *))
+{
+	INIT_HLIST_NODE(&timer->entry);
+	timer->expires = 0;
+	timer->function = callback;
+}
+
+/**
+ * timer_pending - is a timer armed?
+ * @timer: the timer in question
+ *
+ * A timer is not pending any more when its callback is called.
+ */
+static inline bool timer_pending(const struct timer_list *timer)
+{
+	return !hlist_unhashed(&timer->entry);
+}
+
+/**
+ * timer_wheel_init - initialize an empty wheel
+ * @wheel: the wheel to be initialized
+ * @now: the current tick, the first one timer_wheel_run() will expire
+ */
+extern void timer_wheel_init(struct timer_wheel *wheel, unsigned long now);
+
+/**
+ * timer_wheel_add - arm a timer
+ * @wheel: the wheel to be used
+ * @timer: a timer that is not pending
+ * @expires: the tick at which it expires, a past tick expires on the next run
+ */
+extern void timer_wheel_add(struct timer_wheel *wheel, struct timer_list *timer,
+	unsigned long expires);
+
+/**
+ * timer_wheel_del - cancel a timer
+ * @wheel: the wheel the timer was added to
+ * @timer: the timer to be cancelled
+ *
+ * Return 1 if the timer was pending, 0 otherwise.
+ */
+extern int timer_wheel_del(struct timer_wheel *wheel, struct timer_list *timer);
+
+/**
+ * timer_wheel_mod - change the expiry of a timer, arming it if needed
+ * @wheel: the wheel to be used
+ * @timer: the timer to be modified
+ * @expires: the new expiry tick
+ *
+ * Return 1 if the timer was pending, 0 otherwise.
+ */
+extern int timer_wheel_mod(struct timer_wheel *wheel, struct timer_list *timer,
+	unsigned long expires);
+
+/**
+ * timer_wheel_run - expire every timer due up to and including @now
+ * @wheel: the wheel to be used
+ * @now: the current tick
+ *
+ * Return the number of callbacks called.
+ */
+extern unsigned long timer_wheel_run(struct timer_wheel *wheel,
+	unsigned long now);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif